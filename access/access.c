@@ -28,6 +28,36 @@
 #include "pip.h"
 #include "timer.h"
 
+#define ACCESS_MAX_PEP_PLUGINS 8
+
+// The action callback each PEP plugin registered, found again through its callback table.
+typedef struct {
+  void **callbacks;
+  plugin_cb action;
+} access_pep_action_t;
+
+static access_pep_action_t g_pep_actions[ACCESS_MAX_PEP_PLUGINS];
+static int g_pep_actions_num = 0;
+static __thread unsigned g_pep_action_count = 0;
+static __thread int g_pep_dry_run = 0;
+
+static int pep_action_cb(plugin_t *plugin, void *data) {
+  g_pep_action_count++;
+
+  // Counted all the same, so a dry run decision is never mistaken for one without actions.
+  if (g_pep_dry_run) {
+    return 0;
+  }
+
+  for (int i = 0; i < g_pep_actions_num; i++) {
+    if (g_pep_actions[i].callbacks == plugin->callbacks) {
+      return g_pep_actions[i].action(plugin, data);
+    }
+  }
+
+  return -1;
+}
+
 void access_init() {
   pep_init();
   pip_init();
@@ -43,9 +73,25 @@ void access_term() {
 }
 
 int access_register_pep_plugin(plugin_t *plugin) {
+  // Every action goes through pep_action_cb, so callers can tell whether a request ran one.
+  if (plugin->callbacks_num > PEP_PLUGIN_ACTION_CB && plugin->callbacks[PEP_PLUGIN_ACTION_CB] != NULL) {
+    if (g_pep_actions_num == ACCESS_MAX_PEP_PLUGINS) {
+      return -1;
+    }
+    g_pep_actions[g_pep_actions_num].callbacks = plugin->callbacks;
+    g_pep_actions[g_pep_actions_num].action = (plugin_cb)plugin->callbacks[PEP_PLUGIN_ACTION_CB];
+    g_pep_actions_num++;
+    plugin->callbacks[PEP_PLUGIN_ACTION_CB] = pep_action_cb;
+  }
+
   pep_register_plugin(plugin);
+  return 0;
 }
 
+unsigned access_pep_action_count() { return g_pep_action_count; }
+
+void access_pep_dry_run(int enable) { g_pep_dry_run = enable; }
+
 int access_register_pip_plugin(plugin_t *plugin) {
   pip_register_plugin(plugin);
 }
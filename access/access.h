@@ -31,6 +31,14 @@ void access_term();
 
 int access_register_pep_plugin(plugin_t *plugin);
 
+// Number of PEP action callbacks run on the calling thread. pep_request_access runs them on the
+// calling thread, so a count unchanged over a call means no action or obligation was run.
+unsigned access_pep_action_count();
+
+// While enabled, PEP actions and obligations requested on the calling thread are counted and
+// reported as done but not run, so pep_request_access only evaluates the request.
+void access_pep_dry_run(int enable);
+
 int access_register_pip_plugin(plugin_t *plugin);
 
 int access_register_pap_plugin(plugin_t *plugin);
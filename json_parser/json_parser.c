@@ -0,0 +1,94 @@
+/*
+ * This file is part of the IOTA Access distribution
+ * (https://github.com/iotaledger/access)
+ *
+ * Copyright (c) 2020 IOTA Stiftung
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * \project IOTA Access
+ * \file json_parser.c
+ * \brief
+ * Implementation of the reentrant JSON parser
+ *
+ * \notes
+ *
+ * \history
+ * 16.10.2026. Initial version.
+ ****************************************************************************/
+
+#include "json_parser.h"
+
+#include <string.h>
+
+void jsonparser_init(jsonparser_ctx_t *ctx, jsmntok_t *tokens, int max_tokens) {
+  ctx->json = NULL;
+  ctx->tokens = tokens;
+  ctx->max_tokens = max_tokens;
+  ctx->num_of_tokens = 0;
+}
+
+int jsonparser_parse(jsonparser_ctx_t *ctx, const char *json, int json_len) {
+  jsmn_parser parser;
+
+  jsmn_init(&parser);
+  ctx->json = json;
+  ctx->num_of_tokens = jsmn_parse(&parser, json, json_len, ctx->tokens, ctx->max_tokens);
+
+  return ctx->num_of_tokens;
+}
+
+jsmntok_t *jsonparser_token(jsonparser_ctx_t *ctx, int idx) {
+  if (idx < 0 || idx >= ctx->num_of_tokens) {
+    return NULL;
+  }
+
+  return &ctx->tokens[idx];
+}
+
+int jsonparser_skip(jsonparser_ctx_t *ctx, int idx) {
+  // size counts the direct children, and an object key has its value as its only child.
+  int pending = 1;
+
+  while (pending > 0 && idx >= 0 && idx < ctx->num_of_tokens) {
+    pending += ctx->tokens[idx].size - 1;
+    idx++;
+  }
+
+  return idx;
+}
+
+int jsonparser_get_value(jsonparser_ctx_t *ctx, int obj_idx, const char *key) {
+  jsmntok_t *obj = jsonparser_token(ctx, obj_idx);
+  int key_len = strlen(key);
+  int i = obj_idx + 1;
+
+  if (obj == NULL || obj->type != JSMN_OBJECT) {
+    return -1;
+  }
+
+  // The size of an object is its number of keys. Each value is skipped with everything nested in it.
+  for (int k = 0; k < obj->size && i < ctx->num_of_tokens - 1; k++) {
+    jsmntok_t *tok = &ctx->tokens[i];
+
+    if (tok->type == JSMN_STRING && (tok->end - tok->start) == key_len &&
+        memcmp(ctx->json + tok->start, key, key_len) == 0) {
+      return i + 1;
+    }
+    i = jsonparser_skip(ctx, i + 1);
+  }
+
+  return -1;
+}
@@ -0,0 +1,96 @@
+/*
+ * This file is part of the IOTA Access distribution
+ * (https://github.com/iotaledger/access)
+ *
+ * Copyright (c) 2020 IOTA Stiftung
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * \project IOTA Access
+ * \file json_parser.h
+ * \brief
+ * Reentrant JSON parsing on top of jsmn
+ *
+ * \notes
+ * Unlike json_helper, all parser state lives in a context owned by the
+ * caller, so threads can parse in parallel with a context each. The token
+ * storage is also supplied by the caller, e.g. from a connection.
+ *
+ * \history
+ * 16.10.2026. Initial version.
+ ****************************************************************************/
+
+#ifndef _JSON_PARSER_H_
+#define _JSON_PARSER_H_
+
+#include "jsmn.h"
+
+typedef struct {
+  const char *json;
+  jsmntok_t *tokens;
+  int max_tokens;
+  int num_of_tokens;
+} jsonparser_ctx_t;
+
+/**
+ * @brief Bind a parser context to token storage
+ *
+ * @param ctx the parser context
+ * @param tokens token storage, kept by the caller for the lifetime of the context
+ * @param max_tokens number of tokens in the storage
+ */
+void jsonparser_init(jsonparser_ctx_t *ctx, jsmntok_t *tokens, int max_tokens);
+
+/**
+ * @brief Tokenize a JSON text
+ *
+ * @param ctx the parser context
+ * @param json JSON text, kept by the caller while tokens are used
+ * @param json_len JSON text length
+ * @return int number of tokens, negative jsmn error code on errors
+ */
+int jsonparser_parse(jsonparser_ctx_t *ctx, const char *json, int json_len);
+
+/**
+ * @brief Token at an index
+ *
+ * @param ctx the parser context
+ * @param idx token index
+ * @return jsmntok_t* return NULL if idx is out of range
+ */
+jsmntok_t *jsonparser_token(jsonparser_ctx_t *ctx, int idx);
+
+/**
+ * @brief Index of the first token after a value and everything nested in it
+ *
+ * @param ctx the parser context
+ * @param idx index of the value token
+ * @return int index of the next token, num_of_tokens if the value is the last one
+ */
+int jsonparser_skip(jsonparser_ctx_t *ctx, int idx);
+
+/**
+ * @brief Find the value of a key among the direct members of an object
+ *
+ * Keys inside the member values, e.g. of a nested object, are never matched.
+ *
+ * @param ctx the parser context
+ * @param obj_idx index of the object token
+ * @param key key to look for
+ * @return int index of the value token, -1 if the key is not found or obj_idx is not an object
+ */
+int jsonparser_get_value(jsonparser_ctx_t *ctx, int obj_idx, const char *key);
+
+#endif
@@ -19,6 +19,7 @@
 
 #include <signal.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "access.h"
@@ -27,6 +28,7 @@
 #include "network.h"
 #include "pap_plugin_posix.h"
 #include "pep_plugin_print.h"
+#include "pip_plugin_wallet.h"
 #include "policy_loader.h"
 
 #define MAX_CLIENT_NAME 32
@@ -43,6 +45,10 @@ static void signal_handler(int _) { running = 0; }
 static network_ctx_t network_context;
 static wallet_ctx_t *wallet_context;
 
+static int notify_transaction(void *user_data, const char *policy_id, const char *transaction_hash) {
+  return pip_plugin_wallet_notify_transaction((char *)policy_id, strlen(policy_id), (char *)transaction_hash);
+}
+
 int wallet_init() {
   char node_url[MAX_STR_LEN] = {0};
   char seed[SEED_LEN] = {0};
@@ -110,19 +116,38 @@ int main(int argc, char **argv) {
     access_register_pap_plugin(&plugin);
   }
 
+  int wallet_pip = 0;
+  if (wallet_context != NULL && plugin_init(&plugin, pip_plugin_wallet_initializer, wallet_context) == 0) {
+    access_register_pip_plugin(&plugin);
+    wallet_pip = 1;
+  }
+
   // end register plugins
 
-  network_init(&network_context);
+  if (network_init(&network_context) != 0) {
+    fprintf(stderr, "Error initializing Network actor\n");
+    running = 0;
+  }
+  policyloader_set_update_cb(network_invalidate_decisions, network_context);
+  network_set_action_count_cb(network_context, access_pep_action_count);
+  network_set_dry_run_cb(network_context, access_pep_dry_run);
+  if (wallet_pip) {
+    network_set_transaction_cb(network_context, notify_transaction, pip_plugin_wallet_assume_paid, NULL);
+  }
 
   access_start();
-  if (network_start(network_context) != 0) {
+  if (network_context != NULL && network_start(network_context) != 0) {
     fprintf(stderr, "Error starting Network actor\n");
+    // network_start freed the context.
+    policyloader_set_update_cb(NULL, NULL);
+    network_context = NULL;
     running = 0;
   }
 
   while (running == 1) usleep(g_task_sleep_time);
 
   // Stop threads
+  policyloader_set_update_cb(NULL, NULL);
   network_stop(network_context);
 
   access_term();
@@ -0,0 +1,119 @@
+/*
+ * This file is part of the IOTA Access distribution
+ * (https://github.com/iotaledger/access)
+ *
+ * Copyright (c) 2020 IOTA Stiftung
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * \project IOTA Access
+ * \file arena.c
+ * \brief
+ * Implementation of the request arena
+ *
+ * \notes
+ *
+ * \history
+ * 16.10.2026. Initial version.
+ ****************************************************************************/
+
+#include "arena.h"
+
+#include <stdlib.h>
+
+#define ARENA_ALIGN (sizeof(long double))
+
+struct arena_block {
+  arena_block_t *next;
+  size_t size;
+  size_t used;
+  long double data[];
+};
+
+static arena_block_t *block_create(size_t size) {
+  arena_block_t *block = malloc(sizeof(arena_block_t) + size);
+
+  if (block != NULL) {
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+  }
+
+  return block;
+}
+
+static void *block_alloc(arena_block_t *block, size_t len) {
+  if (block == NULL || block->size - block->used < len) {
+    return NULL;
+  }
+
+  void *ptr = (char *)block->data + block->used;
+  block->used += len;
+
+  return ptr;
+}
+
+void arena_init(arena_t *arena, size_t block_size) {
+  arena->first = NULL;
+  arena->extra = NULL;
+  arena->block_size = block_size;
+  arena->used = 0;
+}
+
+void *arena_alloc(arena_t *arena, size_t len) {
+  len = (len + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+  if (arena->first == NULL) {
+    arena->first = block_create(arena->block_size);
+  }
+
+  void *ptr = block_alloc(arena->first, len);
+  if (ptr == NULL) {
+    ptr = block_alloc(arena->extra, len);
+  }
+
+  if (ptr == NULL) {
+    arena_block_t *block = block_create(len > arena->block_size ? len : arena->block_size);
+    if (block == NULL) {
+      return NULL;
+    }
+    block->next = arena->extra;
+    arena->extra = block;
+    ptr = block_alloc(block, len);
+  }
+
+  arena->used += len;
+
+  return ptr;
+}
+
+void arena_reset(arena_t *arena) {
+  while (arena->extra != NULL) {
+    arena_block_t *next = arena->extra->next;
+    free(arena->extra);
+    arena->extra = next;
+  }
+
+  if (arena->first != NULL) {
+    arena->first->used = 0;
+  }
+  arena->used = 0;
+}
+
+void arena_release(arena_t *arena) {
+  arena_reset(arena);
+  free(arena->first);
+  arena->first = NULL;
+}
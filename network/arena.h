@@ -0,0 +1,80 @@
+/*
+ * This file is part of the IOTA Access distribution
+ * (https://github.com/iotaledger/access)
+ *
+ * Copyright (c) 2020 IOTA Stiftung
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * \project IOTA Access
+ * \file arena.h
+ * \brief
+ * Bump allocator for memory that lives as long as one request
+ *
+ * \notes
+ * The first block is kept across resets so a steady request load does not
+ * touch the heap at all. Requests that outgrow it get extra blocks, which
+ * are freed on the next reset.
+ *
+ * \history
+ * 16.10.2026. Initial version.
+ ****************************************************************************/
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+
+typedef struct arena_block arena_block_t;
+
+typedef struct {
+  arena_block_t *first;
+  arena_block_t *extra;
+  size_t block_size;
+  size_t used;  // bytes handed out since the last reset
+} arena_t;
+
+/**
+ * @brief Initialize an arena, no memory is taken until the first allocation
+ *
+ * @param arena the arena
+ * @param block_size size of the first block
+ */
+void arena_init(arena_t *arena, size_t block_size);
+
+/**
+ * @brief Allocate memory, aligned for any type
+ *
+ * @param arena the arena
+ * @param len number of bytes
+ * @return void* return NULL if the heap is exhausted
+ */
+void *arena_alloc(arena_t *arena, size_t len);
+
+/**
+ * @brief Free everything allocated since the last reset
+ *
+ * @param arena the arena
+ */
+void arena_reset(arena_t *arena);
+
+/**
+ * @brief Return all blocks to the heap
+ *
+ * @param arena the arena
+ */
+void arena_release(arena_t *arena);
+
+#endif
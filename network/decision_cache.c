@@ -0,0 +1,178 @@
+/*
+ * This file is part of the IOTA Access distribution
+ * (https://github.com/iotaledger/access)
+ *
+ * Copyright (c) 2020 IOTA Stiftung
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * \project IOTA Access
+ * \file decision_cache.c
+ * \brief
+ * Implementation of the decision cache
+ *
+ * \notes
+ *
+ * \history
+ * 16.10.2026. Initial version.
+ ****************************************************************************/
+
+#include "decision_cache.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DECISIONCACHE_PROBE_LEN 4
+
+typedef struct {
+  char key[DECISIONCACHE_KEY_LEN];
+  int key_len;
+  unsigned version;
+  long long stored_ms;
+  int decision;
+} decisioncache_entry_t;
+
+struct decisioncache {
+  pthread_mutex_t lock;
+  decisioncache_entry_t *entries;
+  int capacity;
+  int ttl_ms;
+  unsigned version;
+};
+
+static uint32_t hash_key(const char *key, int key_len) {
+  uint32_t hash = 2166136261u;
+
+  for (int i = 0; i < key_len; i++) {
+    hash = (hash ^ (unsigned char)key[i]) * 16777619u;
+  }
+
+  return hash;
+}
+
+static int entry_valid(decisioncache_t *dc, decisioncache_entry_t *entry, long long now_ms) {
+  return entry->key_len > 0 && entry->version == dc->version && now_ms - entry->stored_ms < dc->ttl_ms;
+}
+
+decisioncache_t *decisioncache_create(int capacity, int ttl_ms) {
+  if (capacity < 1 || ttl_ms < 1) {
+    return NULL;
+  }
+
+  decisioncache_t *dc = calloc(1, sizeof(decisioncache_t));
+  if (dc == NULL) {
+    return NULL;
+  }
+
+  dc->entries = calloc(capacity, sizeof(decisioncache_entry_t));
+  if (dc->entries == NULL) {
+    free(dc);
+    return NULL;
+  }
+
+  pthread_mutex_init(&dc->lock, NULL);
+  dc->capacity = capacity;
+  dc->ttl_ms = ttl_ms;
+  dc->version = 1;
+
+  return dc;
+}
+
+unsigned decisioncache_version(decisioncache_t *dc) {
+  pthread_mutex_lock(&dc->lock);
+  unsigned version = dc->version;
+  pthread_mutex_unlock(&dc->lock);
+
+  return version;
+}
+
+int decisioncache_get(decisioncache_t *dc, const char *key, int key_len, long long now_ms, int *decision) {
+  int ret = -1;
+
+  if (key_len >= DECISIONCACHE_KEY_LEN) {
+    return -1;
+  }
+
+  uint32_t hash = hash_key(key, key_len);
+
+  pthread_mutex_lock(&dc->lock);
+  for (int i = 0; i < DECISIONCACHE_PROBE_LEN; i++) {
+    decisioncache_entry_t *entry = &dc->entries[(hash + i) % dc->capacity];
+
+    if (entry->key_len == key_len && memcmp(entry->key, key, key_len) == 0) {
+      if (entry_valid(dc, entry, now_ms)) {
+        *decision = entry->decision;
+        ret = 0;
+      }
+      break;
+    }
+  }
+  pthread_mutex_unlock(&dc->lock);
+
+  return ret;
+}
+
+void decisioncache_put(decisioncache_t *dc, const char *key, int key_len, unsigned version, long long now_ms,
+                       int decision) {
+  if (key_len < 1 || key_len >= DECISIONCACHE_KEY_LEN) {
+    return;
+  }
+
+  uint32_t hash = hash_key(key, key_len);
+
+  pthread_mutex_lock(&dc->lock);
+  if (version == dc->version) {
+    decisioncache_entry_t *victim = NULL;
+
+    // Reuse the entry of the same key, else a stale one, else the oldest.
+    for (int i = 0; i < DECISIONCACHE_PROBE_LEN; i++) {
+      decisioncache_entry_t *entry = &dc->entries[(hash + i) % dc->capacity];
+
+      if (entry->key_len == key_len && memcmp(entry->key, key, key_len) == 0) {
+        victim = entry;
+        break;
+      }
+      if (victim == NULL || (entry_valid(dc, victim, now_ms) &&
+                             (!entry_valid(dc, entry, now_ms) || entry->stored_ms < victim->stored_ms))) {
+        victim = entry;
+      }
+    }
+
+    memcpy(victim->key, key, key_len);
+    victim->key_len = key_len;
+    victim->version = version;
+    victim->stored_ms = now_ms;
+    victim->decision = decision;
+  }
+  pthread_mutex_unlock(&dc->lock);
+}
+
+void decisioncache_invalidate(decisioncache_t *dc) {
+  pthread_mutex_lock(&dc->lock);
+  dc->version++;
+  pthread_mutex_unlock(&dc->lock);
+}
+
+void decisioncache_destroy(decisioncache_t *dc) {
+  if (dc == NULL) {
+    return;
+  }
+
+  pthread_mutex_destroy(&dc->lock);
+  free(dc->entries);
+  free(dc);
+}
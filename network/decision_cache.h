@@ -0,0 +1,100 @@
+/*
+ * This file is part of the IOTA Access distribution
+ * (https://github.com/iotaledger/access)
+ *
+ * Copyright (c) 2020 IOTA Stiftung
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * \project IOTA Access
+ * \file decision_cache.h
+ * \brief
+ * Cache of PDP decisions
+ *
+ * \notes
+ * Entries carry the cache version they were computed under. Any change of
+ * policies or attributes bumps the version, which makes every older entry a
+ * miss without walking the table.
+ *
+ * \history
+ * 16.10.2026. Initial version.
+ ****************************************************************************/
+
+#ifndef _DECISION_CACHE_H_
+#define _DECISION_CACHE_H_
+
+#define DECISIONCACHE_KEY_LEN 256
+
+typedef struct decisioncache decisioncache_t;
+
+/**
+ * @brief Create a decision cache
+ *
+ * @param capacity number of cached decisions
+ * @param ttl_ms lifetime of a decision, bounds staleness of time dependent attributes
+ * @return decisioncache_t* return NULL on errors
+ */
+decisioncache_t *decisioncache_create(int capacity, int ttl_ms);
+
+/**
+ * @brief Current cache version, to be read before evaluating a decision that will be stored
+ *
+ * @param dc the decision cache
+ * @return unsigned current version
+ */
+unsigned decisioncache_version(decisioncache_t *dc);
+
+/**
+ * @brief Look up a decision
+ *
+ * @param dc the decision cache
+ * @param key decision key
+ * @param key_len key length
+ * @param now_ms current monotonic time in milliseconds
+ * @param decision set to the cached decision on a hit
+ * @return int 0 on a hit, -1 otherwise
+ */
+int decisioncache_get(decisioncache_t *dc, const char *key, int key_len, long long now_ms, int *decision);
+
+/**
+ * @brief Store a decision
+ *
+ * The decision is dropped if the cache was invalidated since version was read.
+ *
+ * @param dc the decision cache
+ * @param key decision key, not stored if DECISIONCACHE_KEY_LEN or longer
+ * @param key_len key length
+ * @param version cache version read before the decision was evaluated
+ * @param now_ms current monotonic time in milliseconds
+ * @param decision the decision
+ */
+void decisioncache_put(decisioncache_t *dc, const char *key, int key_len, unsigned version, long long now_ms,
+                       int decision);
+
+/**
+ * @brief Invalidate every cached decision
+ *
+ * @param dc the decision cache
+ */
+void decisioncache_invalidate(decisioncache_t *dc);
+
+/**
+ * @brief Free the decision cache
+ *
+ * @param dc the decision cache
+ */
+void decisioncache_destroy(decisioncache_t *dc);
+
+#endif
@@ -31,6 +31,9 @@
  * 07.11.2019. Initial version.
  ****************************************************************************/
 
+// struct ucred for SO_PEERCRED
+#define _GNU_SOURCE
+
 #include "tcpip.h"
 #include "network.h"
 #include "auth.h"
@@ -39,21 +42,35 @@
 #include "network_logger.h"
 
 #include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <pthread.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "arena.h"
 #include "auth_helper.h"
 #include "config_manager.h"
+#include "decision_cache.h"
 #include "globals_declarations.h"
-#include "json_helper.h"
+#include "json_parser.h"
 #include "pap.h"
 #include "pap_plugin.h"
 #include "pep.h"
 #include "pip.h"
 #include "policy_updater.h"
+#include "rate_limiter.h"
+#include "single_flight.h"
 #include "utils.h"
+#include "worker_pool.h"
 
 #define SEND_BUFF_LEN 4096
 #define READ_BUFF_LEN 1025
@@ -61,15 +78,51 @@
 #define CONNECTION_BACKLOG_LEN 10
 #define POL_ID_HEX_LEN 32
 #define POL_ID_STR_LEN 64
+#define NETWORK_TX_HASH_LEN 81
 #define USERNAME_LEN 128
 #define USER_DATA_LEN 4096
-#define TIME_50MS 50000
-#define MAX_TRY_NUM 350
+#define UNIX_PATH_LEN 108
+#define NETWORK_MAX_CONNECTIONS 32
+#define NETWORK_MAX_EVENTS 16
+#define NETWORK_EPOLL_TIMEOUT_MS 50
+#define NETWORK_DEFAULT_HELLO_TIMEOUT_MS 2000
+#define NETWORK_DEFAULT_HANDSHAKE_TIMEOUT_MS 5000
+#define NETWORK_DEFAULT_REQUEST_TIMEOUT_MS 5000
+#define NETWORK_DEFAULT_RESPONSE_TIMEOUT_MS 5000
+#define NETWORK_DEFAULT_WORKERS 2
+#define NETWORK_DEFAULT_QUEUE_LEN 16
+#define NETWORK_DEFAULT_DECISION_WEIGHT 8
+#define NETWORK_DEFAULT_CLIENT_IO_WEIGHT 4
+#define NETWORK_DEFAULT_DATASET_WEIGHT 2
+#define NETWORK_DEFAULT_ADMIN_WEIGHT 1
+#define NETWORK_DEFAULT_SESSION_IDLE_MS 30000
+#define NETWORK_DEFAULT_RATE_BURST 10
+#define NETWORK_DEFAULT_BUSY_RETRY_MS 100
+#define NETWORK_RATE_TABLE_LEN 256
+#define NETWORK_RESOLVE_FLIGHTS 32
+#define NETWORK_DEFAULT_DECISION_TTL_MS 1000
+#define NETWORK_MAX_BATCH 32
+#define NETWORK_MAX_TOKENS 256
+#define NETWORK_DEFAULT_ARENA_LEN (16 * 1024)
+#define NETWORK_RESPONSE_IOV_MAX 8
+#define NETWORK_MAX_MESSAGE_LEN 65535
+#define NETWORK_RENDER_LEN (64 * 1024)
+#define NETWORK_STREAM_DEFAULT_LIMIT 16
+#define NETWORK_STREAM_MAX_LIMIT 64
+#define NETWORK_BINARY_MAGIC 0xA5
+#define NETWORK_BINARY_STRING 0x80
+#define NETWORK_BINARY_TAG_MASK 0x3F
+#define NETWORK_BINARY_HEADER_LEN 2
+#define NETWORK_BINARY_TLV_HEADER_LEN 3
+#define NETWORK_BINARY_FIELD_OVERHEAD 8  // ,"":"" around a key and its value, plus the closing }
+// A 3 byte TLV header grows into at most the longest key plus NETWORK_BINARY_FIELD_OVERHEAD.
+#define NETWORK_BINARY_JSON_LEN(msg_len) (BUF_LEN + 8 * (msg_len))
 
 #define NO_ERROR 0
 #define ERROR_BIND_FAILED 1
 #define ERROR_LISTEN_FAILED 2
 #define ERROR_CREATE_THREAD_FAILED 3
+#define ERROR_EPOLL_FAILED 4
 
 #define COMMAND_RESOLVE 0
 #define COMMAND_GET_POL_LIST 1
@@ -82,26 +135,218 @@
 #define COMMAND_GET_ALL_USER 8
 #define COMMAND_CLEAR_ALL_USER 9
 #define COMMAND_NOTIFY_TRANSACTION 10
+#define COMMAND_RESOLVE_BATCH 12
+#define COMMAND_COUNT 13
+
+// Priority lanes of the work queue, from the most latency critical to bulk administration.
+typedef enum {
+  NETWORK_LANE_DECISION = 0,  // access decisions
+  NETWORK_LANE_CLIENT_IO,     // handshakes and request reads, which block on the client
+  NETWORK_LANE_DATASET,       // dataset and policy list traffic
+  NETWORK_LANE_ADMIN,         // user management, and requests that could not be classified
+  NETWORK_LANE_COUNT
+} network_lane_e;
+
+// Every phase of a connection has a deadline, so a client cannot hold a slot by going quiet.
+typedef enum {
+  NETWORK_PHASE_HELLO = 0,  // accepted, waiting for the first bytes of the handshake
+  NETWORK_PHASE_HANDSHAKE,
+  NETWORK_PHASE_REQUEST,
+  NETWORK_PHASE_RESPONSE,  // queued, evaluated and answered by a worker
+  NETWORK_PHASE_IDLE,      // session mode, waiting for the next request
+  NETWORK_PHASE_COUNT
+} network_phase_e;
+
+static const char *g_phase_names[NETWORK_PHASE_COUNT] = {"hello", "handshake", "request", "response", "idle"};
+
+typedef enum {
+  NETWORK_CONN_FREE = 0,
+  NETWORK_CONN_ACCEPTED,
+  NETWORK_CONN_AUTHENTICATED,
+  NETWORK_CONN_BUSY,
+} network_conn_state_e;
+
+// What a worker does with a busy connection. The auth layer blocks on the socket, so the event loop
+// never calls it and only hands ready connections over.
+typedef enum {
+  NETWORK_TASK_HANDSHAKE = 0,  // authenticate a new connection
+  NETWORK_TASK_RECEIVE,        // read the next request of an authenticated connection
+  NETWORK_TASK_DISPATCH,       // evaluate a received request and answer it
+} network_task_e;
+
+// Snapshot of a large result that a client reads page by page.
+typedef struct {
+  int command;
+  char *data;
+  int *bounds;  // start and end offset of each array element in data
+  int count;
+} network_stream_t;
+
+// State of an authenticated client, kept from the handshake until the connection closes.
+typedef struct {
+  auth_ctx_t auth;
+  int has_auth;
+  int fd;
+  unsigned int request_count;
+  network_stream_t stream;
+} network_session_t;
 
 typedef struct {
+  int fd;
+  network_conn_state_e state;
+  network_task_e task;
+  network_session_t *session;
+  char *recv_data;
+  unsigned short recv_len;
+  network_phase_e phase;
+  long long deadline_ms;
+  jsonparser_ctx_t parser;
+  arena_t arena;  // everything allocated for the request being handled, reset once it is answered
+} network_connection_t;
+
+// The SDK renders replies without a length limit, so the buffer has room for the largest message.
+typedef struct {
+  char send_buffer[NETWORK_RENDER_LEN];
+} network_worker_t;
+
+typedef struct network_ctx_internal {
   pthread_t thread;
-  auth_ctx_t session;
-  int state;
   int DAC_AUTH;
-  char send_buffer[SEND_BUFF_LEN];
 
   unsigned short port;
   int end;
 
   int listenfd;
-  int connfd;
+  int unix_listenfd;
+  char unix_path[UNIX_PATH_LEN];
+  int unix_allowed_uid;
+  int epollfd;
+  pthread_mutex_t conn_lock;
+  network_connection_t connections[NETWORK_MAX_CONNECTIONS];
+
+  workerpool_t *pool;
+  network_worker_t *workers;
+  int num_workers;
+  int queue_len;
+  int lane_weights[NETWORK_LANE_COUNT];
+  int client_io_workers;
+
+  int session_mode;
+  int phase_timeout_ms[NETWORK_PHASE_COUNT];
+  unsigned long timeouts[NETWORK_PHASE_COUNT];
+
+  network_transaction_cb transaction_cb;
+  network_assume_paid_cb assume_paid_cb;
+  void *transaction_cb_data;
+  network_action_count_cb action_count_cb;
+  network_dry_run_cb dry_run_cb;
+
+  // Extra listeners sharing the TCP port through SO_REUSEPORT, each with its own loop and workers.
+  int num_listeners;
+  struct network_ctx_internal *shards;
+  int num_shards;
+
+  // Admission control, checked before the handshake so an overloaded server answers cheaply.
+  int max_connections;
+  int listen_backlog;
+  int busy_retry_ms;
+  ratelimiter_t *rate_limiter;
+
+  singleflight_t *resolve_flight;
+  decisioncache_t *decision_cache;
+
+  int arena_len;
+  size_t arena_high_water;
 } network_ctx_internal_t;
 
+typedef struct {
+  int key_start;
+  int start;
+  int len;
+  jsmntype_t type;
+} network_slice_t;
+
+// Fields of a request, as slices of the received message. A field that is not present has len -1.
+typedef struct {
+  char *data;
+  network_slice_t cmd;
+  network_slice_t policy_id;
+  network_slice_t user_id;
+  network_slice_t username;
+  network_slice_t user;
+  network_slice_t dataset_list;
+  network_slice_t policy_ids;
+  network_slice_t cursor;
+  network_slice_t limit;
+  network_slice_t transaction_hash;
+} network_request_t;
+
+typedef struct {
+  const char *key;
+  size_t offset;
+} network_field_t;
+
+// A response is a list of references to buffers that already hold its parts, such as static
+// replies or the output of the PAP, so handlers do not copy them into one send buffer.
+typedef struct {
+  struct iovec iov[NETWORK_RESPONSE_IOV_MAX];
+  int iovcnt;
+  size_t len;
+  char *buffer;  // worker owned, NETWORK_RENDER_LEN bytes for handlers to render into
+} network_response_t;
+
+typedef void (*network_cmd_handler_t)(network_ctx_internal_t *ctx, network_connection_t *conn, network_request_t *req,
+                                      network_response_t *resp);
+
+typedef struct {
+  const char *name;
+  network_cmd_handler_t handler;
+  network_lane_e lane;
+} network_command_t;
+
+// auth_helper_check_msg_format may use the global json_helper state, so workers take turns calling it.
+static pthread_mutex_t g_json_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static void *network_thread_function(void *ptr);
+static void connection_job(void *job, int worker_idx, void *user_data);
+static void connection_close(network_ctx_internal_t *ctx, network_connection_t *conn);
+static int unix_listener_open(network_ctx_internal_t *ctx);
+
+static void connections_init(network_ctx_internal_t *ctx) {
+  memset(ctx->connections, 0, sizeof(ctx->connections));
+  for (int i = 0; i < NETWORK_MAX_CONNECTIONS; i++) {
+    arena_init(&ctx->connections[i].arena, ctx->arena_len);
+  }
+}
+
+static void connections_release(network_ctx_internal_t *ctx) {
+  for (int i = 0; i < NETWORK_MAX_CONNECTIONS; i++) {
+    arena_release(&ctx->connections[i].arena);
+  }
+  pthread_mutex_destroy(&ctx->conn_lock);
+}
+
+// Frees what the first listener shares with its shards, once no listener runs anymore.
+static void network_free(network_ctx_internal_t *ctx) {
+  free(ctx->shards);
+  ratelimiter_destroy(ctx->rate_limiter);
+  singleflight_destroy(ctx->resolve_flight);
+  decisioncache_destroy(ctx->decision_cache);
+  free(ctx);
+}
 
 int network_init(network_ctx_t *network_context) {
   network_ctx_internal_t *ctx = malloc(sizeof(network_ctx_internal_t));
 
+  *network_context = NULL;
+  if (ctx == NULL) {
+    return -1;
+  }
+
+  logger_init_network(LOGGER_INFO);
+  logger_init_auth(LOGGER_INFO);
+  logger_init_crypto(LOGGER_INFO);
+
   config_manager_init("config.ini");
   int tcp_port;
   if (CONFIG_MANAGER_OK != config_manager_get_option_int("network", "tcp_port", &tcp_port)) {
@@ -110,322 +355,1655 @@ int network_init(network_ctx_t *network_context) {
     ctx->port = tcp_port;
   }
 
-  ctx->state = 0;
+  if (CONFIG_MANAGER_OK != config_manager_get_option_int("network", "worker_threads", &ctx->num_workers) ||
+      ctx->num_workers < 1) {
+    ctx->num_workers = NETWORK_DEFAULT_WORKERS;
+  }
+
+  if (CONFIG_MANAGER_OK != config_manager_get_option_int("network", "work_queue_len", &ctx->queue_len) ||
+      ctx->queue_len < 1) {
+    ctx->queue_len = NETWORK_DEFAULT_QUEUE_LEN;
+  }
+
+  ctx->lane_weights[NETWORK_LANE_DECISION] = NETWORK_DEFAULT_DECISION_WEIGHT;
+  ctx->lane_weights[NETWORK_LANE_CLIENT_IO] = NETWORK_DEFAULT_CLIENT_IO_WEIGHT;
+  ctx->lane_weights[NETWORK_LANE_DATASET] = NETWORK_DEFAULT_DATASET_WEIGHT;
+  ctx->lane_weights[NETWORK_LANE_ADMIN] = NETWORK_DEFAULT_ADMIN_WEIGHT;
+  config_manager_get_option_int("network", "decision_lane_weight", &ctx->lane_weights[NETWORK_LANE_DECISION]);
+  config_manager_get_option_int("network", "client_io_lane_weight", &ctx->lane_weights[NETWORK_LANE_CLIENT_IO]);
+  config_manager_get_option_int("network", "dataset_lane_weight", &ctx->lane_weights[NETWORK_LANE_DATASET]);
+  config_manager_get_option_int("network", "admin_lane_weight", &ctx->lane_weights[NETWORK_LANE_ADMIN]);
+
+  // Clients that stall mid handshake hold their worker until the deadline, so they never get all
+  // workers: at least one is always left for decisions. With a single worker nothing can be kept.
+  int max_client_io = ctx->num_workers > 1 ? ctx->num_workers - 1 : 1;
+  if (CONFIG_MANAGER_OK != config_manager_get_option_int("network", "client_io_workers", &ctx->client_io_workers) ||
+      ctx->client_io_workers < 1 || ctx->client_io_workers > max_client_io) {
+    ctx->client_io_workers = max_client_io;
+  }
+
+  if (CONFIG_MANAGER_OK != config_manager_get_option_int("network", "session_mode", &ctx->session_mode)) {
+    ctx->session_mode = 0;
+  }
+
+  static const struct {
+    const char *key;
+    int default_ms;
+  } phase_options[NETWORK_PHASE_COUNT] = {
+      [NETWORK_PHASE_HELLO] = {"hello_timeout_ms", NETWORK_DEFAULT_HELLO_TIMEOUT_MS},
+      [NETWORK_PHASE_HANDSHAKE] = {"handshake_timeout_ms", NETWORK_DEFAULT_HANDSHAKE_TIMEOUT_MS},
+      [NETWORK_PHASE_REQUEST] = {"request_timeout_ms", NETWORK_DEFAULT_REQUEST_TIMEOUT_MS},
+      [NETWORK_PHASE_RESPONSE] = {"response_timeout_ms", NETWORK_DEFAULT_RESPONSE_TIMEOUT_MS},
+      [NETWORK_PHASE_IDLE] = {"session_idle_timeout_ms", NETWORK_DEFAULT_SESSION_IDLE_MS},
+  };
+  for (int phase = 0; phase < NETWORK_PHASE_COUNT; phase++) {
+    if (CONFIG_MANAGER_OK !=
+            config_manager_get_option_int("network", phase_options[phase].key, &ctx->phase_timeout_ms[phase]) ||
+        ctx->phase_timeout_ms[phase] < 1) {
+      ctx->phase_timeout_ms[phase] = phase_options[phase].default_ms;
+    }
+  }
+  memset(ctx->timeouts, 0, sizeof(ctx->timeouts));
+
+  if (CONFIG_MANAGER_OK != config_manager_get_option_int("network", "listener_threads", &ctx->num_listeners) ||
+      ctx->num_listeners < 1) {
+    ctx->num_listeners = 1;
+  }
+
+  if (CONFIG_MANAGER_OK != config_manager_get_option_int("network", "max_connections", &ctx->max_connections) ||
+      ctx->max_connections < 1 || ctx->max_connections > NETWORK_MAX_CONNECTIONS) {
+    ctx->max_connections = NETWORK_MAX_CONNECTIONS;
+  }
+
+  if (CONFIG_MANAGER_OK != config_manager_get_option_int("network", "listen_backlog", &ctx->listen_backlog) ||
+      ctx->listen_backlog < 1) {
+    ctx->listen_backlog = CONNECTION_BACKLOG_LEN;
+  }
+
+  if (CONFIG_MANAGER_OK != config_manager_get_option_int("network", "busy_retry_ms", &ctx->busy_retry_ms) ||
+      ctx->busy_retry_ms < 1) {
+    ctx->busy_retry_ms = NETWORK_DEFAULT_BUSY_RETRY_MS;
+  }
+
+  int rate_limit_per_s = 0;
+  int rate_limit_burst = NETWORK_DEFAULT_RATE_BURST;
+  config_manager_get_option_int("network", "rate_limit_per_s", &rate_limit_per_s);
+  config_manager_get_option_int("network", "rate_limit_burst", &rate_limit_burst);
+  ctx->rate_limiter = NULL;
+  if (rate_limit_per_s > 0) {
+    // A limit that was asked for but cannot be enforced must not leave the server open.
+    if (rate_limit_burst < 1) {
+      log_error(network_logger_id, "[%s:%d] rate_limit_burst must be at least 1, got %d.\n", __func__, __LINE__,
+                rate_limit_burst);
+      free(ctx);
+      return -1;
+    }
+
+    ctx->rate_limiter = ratelimiter_create(NETWORK_RATE_TABLE_LEN, rate_limit_per_s, rate_limit_burst);
+    if (ctx->rate_limiter == NULL) {
+      log_error(network_logger_id, "[%s:%d] rate limiter not created.\n", __func__, __LINE__);
+      free(ctx);
+      return -1;
+    }
+  }
+
+  int coalesce_resolve = 0;
+  config_manager_get_option_int("network", "coalesce_resolve", &coalesce_resolve);
+  ctx->resolve_flight = NULL;
+  if (coalesce_resolve) {
+    ctx->resolve_flight = singleflight_create(NETWORK_RESOLVE_FLIGHTS);
+  }
+
+  int decision_cache_len = 0;
+  int decision_ttl_ms = NETWORK_DEFAULT_DECISION_TTL_MS;
+  config_manager_get_option_int("network", "decision_cache_len", &decision_cache_len);
+  config_manager_get_option_int("network", "decision_cache_ttl_ms", &decision_ttl_ms);
+  ctx->decision_cache = NULL;
+  if (decision_cache_len > 0) {
+    ctx->decision_cache = decisioncache_create(decision_cache_len, decision_ttl_ms);
+  }
+
+  if (CONFIG_MANAGER_OK != config_manager_get_option_int("network", "request_arena_len", &ctx->arena_len) ||
+      ctx->arena_len < 1) {
+    ctx->arena_len = NETWORK_DEFAULT_ARENA_LEN;
+  }
+  ctx->arena_high_water = 0;
+
+  ctx->unix_path[0] = '\0';
+  config_manager_get_option_string("network", "unix_socket_path", ctx->unix_path, UNIX_PATH_LEN);
+  if (CONFIG_MANAGER_OK != config_manager_get_option_int("network", "unix_allowed_uid", &ctx->unix_allowed_uid)) {
+    ctx->unix_allowed_uid = -1;
+  }
+
+  ctx->transaction_cb = NULL;
+  ctx->assume_paid_cb = NULL;
+  ctx->transaction_cb_data = NULL;
+  ctx->action_count_cb = NULL;
+  ctx->dry_run_cb = NULL;
+
   ctx->DAC_AUTH = 1;
   ctx->end = 0;
   ctx->listenfd = 0;
-  ctx->connfd = 0;
+  ctx->unix_listenfd = -1;
+  ctx->epollfd = -1;
+  pthread_mutex_init(&ctx->conn_lock, NULL);
+  connections_init(ctx);
+  ctx->pool = NULL;
+  ctx->workers = NULL;
+  ctx->shards = NULL;
+  ctx->num_shards = 0;
 
   policyupdater_init();
 
   *network_context = (void *)ctx;
 
-  logger_init_network(LOGGER_INFO);
-  logger_init_auth(LOGGER_INFO);
-  logger_init_crypto(LOGGER_INFO);
-
   return 0;
 }
 
-int network_start(network_ctx_t network_context) {
-  network_ctx_internal_t *ctx = (network_ctx_internal_t *)network_context;
+// Frees what listener_start set up, in reverse order. The loop thread must not be running.
+static void listener_close(network_ctx_internal_t *ctx) {
+  workerpool_destroy(ctx->pool);
+  ctx->pool = NULL;
+  free(ctx->workers);
+  ctx->workers = NULL;
+  if (ctx->unix_listenfd >= 0) {
+    close(ctx->unix_listenfd);
+    unlink(ctx->unix_path);
+    ctx->unix_listenfd = -1;
+  }
+  close(ctx->epollfd);
+  ctx->epollfd = -1;
+  close(ctx->listenfd);
+}
 
+static int listener_start(network_ctx_internal_t *ctx) {
   struct sockaddr_in serv_addr;
-  char read_buffer[READ_BUFF_LEN];
 
   ctx->listenfd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (ctx->listenfd < 0) {
+    log_error(network_logger_id, "[%s:%d] could not create socket.\n", __func__, __LINE__);
+    return ERROR_BIND_FAILED;
+  }
   memset(&serv_addr, '0', sizeof(serv_addr));
-  memset(read_buffer, '0', sizeof(read_buffer));
 
   serv_addr.sin_family = AF_INET;
   serv_addr.sin_addr.s_addr = htonl(INADDR_ANY);
   serv_addr.sin_port = htons(ctx->port);
 
+  if (ctx->num_listeners > 1) {
+    int reuse = 1;
+    setsockopt(ctx->listenfd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse));
+  }
+
   int retstat = bind(ctx->listenfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr));
   if (retstat != 0) {
     log_error(network_logger_id, "[%s:%d] bind failed.\n", __func__, __LINE__);
-    free(ctx);
+    close(ctx->listenfd);
     return ERROR_BIND_FAILED;
   }
 
   if (ctx->end != 1) {
-    retstat = listen(ctx->listenfd, CONNECTION_BACKLOG_LEN);
+    retstat = listen(ctx->listenfd, ctx->listen_backlog);
     if (retstat != 0) {
       log_error(network_logger_id, "[%s:%d] listen failed.\n", __func__, __LINE__);
-      free(ctx);
+      close(ctx->listenfd);
       return ERROR_LISTEN_FAILED;
     }
   }
 
+  fcntl(ctx->listenfd, F_SETFL, fcntl(ctx->listenfd, F_GETFL, 0) | O_NONBLOCK);
+
+  ctx->epollfd = epoll_create1(0);
+  if (ctx->epollfd < 0) {
+    log_error(network_logger_id, "[%s:%d] epoll create failed.\n", __func__, __LINE__);
+    close(ctx->listenfd);
+    return ERROR_EPOLL_FAILED;
+  }
+
+  struct epoll_event ev = {0};
+  ev.events = EPOLLIN;
+  ev.data.ptr = &ctx->listenfd;
+  if (epoll_ctl(ctx->epollfd, EPOLL_CTL_ADD, ctx->listenfd, &ev) != 0) {
+    log_error(network_logger_id, "[%s:%d] epoll add listener failed.\n", __func__, __LINE__);
+    close(ctx->epollfd);
+    close(ctx->listenfd);
+    return ERROR_EPOLL_FAILED;
+  }
+
+  // The local listener is optional, the server keeps serving TCP if it cannot be opened.
+  if (ctx->unix_path[0] != '\0' && unix_listener_open(ctx) != 0) {
+    log_error(network_logger_id, "[%s:%d] unix socket %s not available.\n", __func__, __LINE__, ctx->unix_path);
+  }
+
+  ctx->workers = calloc(ctx->num_workers, sizeof(network_worker_t));
+  ctx->pool =
+      workerpool_create(ctx->num_workers, ctx->queue_len, NETWORK_LANE_COUNT, ctx->lane_weights, connection_job, ctx);
+  if (ctx->workers == NULL || ctx->pool == NULL ||
+      workerpool_set_lane_limit(ctx->pool, NETWORK_LANE_CLIENT_IO, ctx->client_io_workers) != 0) {
+    log_error(network_logger_id, "[%s:%d] error creating worker pool.\n", __func__, __LINE__);
+    listener_close(ctx);
+    return ERROR_CREATE_THREAD_FAILED;
+  }
+
   if (pthread_create(&ctx->thread, NULL, network_thread_function, ctx)) {
     log_error(network_logger_id, "[%s:%d] error creating thread.\n", __func__, __LINE__);
-    free(ctx);
+    listener_close(ctx);
     return ERROR_CREATE_THREAD_FAILED;
   }
 
   return NO_ERROR;
 }
 
+// The loop is stopped first, then the workers, and only then the connections are torn down, as
+// a running job still uses its connection and the epoll instance.
+static void listener_stop(network_ctx_internal_t *ctx) {
+  ctx->end = 1;
+  pthread_join(ctx->thread, NULL);
+
+  // Fails the blocking reads and writes of running jobs, so the workers exit without waiting out
+  // their phase timeouts. Queued jobs still run and fail fast on the shut down sockets.
+  pthread_mutex_lock(&ctx->conn_lock);
+  for (int i = 0; i < NETWORK_MAX_CONNECTIONS; i++) {
+    if (ctx->connections[i].state == NETWORK_CONN_BUSY) {
+      shutdown(ctx->connections[i].fd, SHUT_RDWR);
+    }
+  }
+  pthread_mutex_unlock(&ctx->conn_lock);
+
+  workerpool_destroy(ctx->pool);
+  ctx->pool = NULL;
+
+  // Jobs of a stopping listener leave their connection open instead of re-arming it.
+  for (int i = 0; i < NETWORK_MAX_CONNECTIONS; i++) {
+    if (ctx->connections[i].state != NETWORK_CONN_FREE) {
+      connection_close(ctx, &ctx->connections[i]);
+    }
+  }
+
+  listener_close(ctx);
+  connections_release(ctx);
+}
+
+int network_start(network_ctx_t network_context) {
+  network_ctx_internal_t *ctx = (network_ctx_internal_t *)network_context;
+
+  int ret = listener_start(ctx);
+  if (ret != NO_ERROR) {
+    connections_release(ctx);
+    network_free(ctx);
+    return ret;
+  }
+
+  if (ctx->num_listeners > 1) {
+    ctx->shards = calloc(ctx->num_listeners - 1, sizeof(network_ctx_internal_t));
+  }
+
+  // Shards copy the configuration of the first listener.
+  for (int i = 0; ctx->shards != NULL && i < ctx->num_listeners - 1; i++) {
+    network_ctx_internal_t *shard = &ctx->shards[i];
+
+    memcpy(shard, ctx, sizeof(network_ctx_internal_t));
+    shard->unix_listenfd = -1;
+    shard->unix_path[0] = '\0';
+    shard->epollfd = -1;
+    pthread_mutex_init(&shard->conn_lock, NULL);
+    shard->arena_high_water = 0;
+    connections_init(shard);
+    shard->pool = NULL;
+    shard->workers = NULL;
+    shard->shards = NULL;
+    shard->num_shards = 0;
+
+    if (listener_start(shard) != NO_ERROR) {
+      log_error(network_logger_id, "[%s:%d] listener %d not started.\n", __func__, __LINE__, i + 1);
+      connections_release(shard);
+      break;
+    }
+    ctx->num_shards++;
+  }
+
+  return NO_ERROR;
+}
+
 void network_stop(network_ctx_t network_context) {
   network_ctx_internal_t *ctx = (network_ctx_internal_t *)network_context;
   if (ctx != NULL) {
-    ctx->end = 1;
-    pthread_join(ctx->thread, NULL);
-    free(ctx);
+    for (int i = 0; i < ctx->num_shards; i++) {
+      listener_stop(&ctx->shards[i]);
+    }
+    listener_stop(ctx);
+    network_free(ctx);
   }
 }
 
-static int get_server_state(network_ctx_internal_t *ctx) { return ctx->state; }
+void network_invalidate_decisions(network_ctx_t network_context) {
+  network_ctx_internal_t *ctx = (network_ctx_internal_t *)network_context;
+  if (ctx != NULL && ctx->decision_cache != NULL) {
+    decisioncache_invalidate(ctx->decision_cache);
+  }
+}
 
-static unsigned int calculate_decision(char **recv_data, network_ctx_internal_t *ctx) {
-  int request_code = -1;
-  unsigned int buffer_position = 0;
+void network_set_transaction_cb(network_ctx_t network_context, network_transaction_cb cb,
+                                network_assume_paid_cb assume_paid_cb, void *user_data) {
+  network_ctx_internal_t *ctx = (network_ctx_internal_t *)network_context;
+  if (ctx != NULL) {
+    ctx->transaction_cb = cb;
+    ctx->assume_paid_cb = assume_paid_cb;
+    ctx->transaction_cb_data = user_data;
+  }
+}
 
-  char grant[] = "{\"response\":\"access granted\"}";
-  char deny[] = "{\"response\":\"access denied \"}";
-  char *msg;
+void network_set_action_count_cb(network_ctx_t network_context, network_action_count_cb cb) {
+  network_ctx_internal_t *ctx = (network_ctx_internal_t *)network_context;
+  if (ctx != NULL) {
+    ctx->action_count_cb = cb;
+  }
+}
 
-  int num_of_tokens = jsonhelper_parser_init(*recv_data);
+void network_set_dry_run_cb(network_ctx_t network_context, network_dry_run_cb cb) {
+  network_ctx_internal_t *ctx = (network_ctx_internal_t *)network_context;
+  if (ctx != NULL) {
+    ctx->dry_run_cb = cb;
+  }
+}
 
-  request_code = auth_helper_check_msg_format(*recv_data);
+static int unix_listener_open(network_ctx_internal_t *ctx) {
+  struct sockaddr_un addr = {0};
 
-  if (request_code == COMMAND_RESOLVE) {
-    char decision[BUF_LEN] = {0};
-    //@TODO: Should this be moved to access actor? Network should just send cb here to notify request.
-    pep_request_access(*recv_data, (void *)decision);
+  ctx->unix_listenfd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (ctx->unix_listenfd < 0) {
+    return -1;
+  }
 
-    if (memcmp(decision, "grant", strlen("grant"))) {
-      msg = grant;
-    } else {
-      msg = deny;
-    }
-
-    if (ctx->DAC_AUTH == 1) {
-      free(*recv_data);
-    }
-
-    memcpy(ctx->send_buffer, msg, sizeof(grant));
-    *recv_data = ctx->send_buffer;
-    buffer_position = sizeof(grant);
-  } else if (request_code == COMMAND_GET_POL_LIST) {
-    //@TODO: Should this be moved to access actor? Network should just send cb here to notify request.
-    pep_request_access(*recv_data, (void *)ctx->send_buffer);
-
-    buffer_position = strlen(ctx->send_buffer);
-
-    if (ctx->DAC_AUTH == 1) {
-      free(*recv_data);
-    }
-
-    *recv_data = ctx->send_buffer;
-  } else if (request_code == COMMAND_ENABLE_POLICY) {
-    //@FIXME: Will be refactored
-#if 0
-        int policy_id_index = -1;
-
-        for (int i = 0; i < num_of_tokens; i++)
-        {
-            if (memcmp(*recv_data + jsonhelper_get_token_start(i), "policy_id", strlen("policy_id")) == 0)
-            {
-                policy_id_index = i + 1;
-                break;
-            }
-        }
-
-        if (policy_id_index == -1)
-        {
-            return buffer_position;
-        }
-
-        char* pol_id_hex = calloc(jsonhelper_token_size(policy_id_index) / 2, 1);
-        str_to_hex(*recv_data + jsonhelper_get_token_start(policy_id_index), pol_id_hex, jsonhelper_token_size(policy_id_index));
-
-        int ret = -1;
-
-        if (pol_id_hex != NULL)
-        {
-            ret = PolicyStore_enable_policy(pol_id_hex, jsonhelper_token_size(policy_id_index) / 2);
-        }
-        free(pol_id_hex);
-
-        if (ret == 0)
-        {
-            memcpy(send_buffer, grant, sizeof(grant));
-            *recv_data = send_buffer;
-            buffer_position = sizeof(grant);
-        }
-        else
-        {
-            memcpy(send_buffer, deny, sizeof(deny));
-            *recv_data = send_buffer;
-            buffer_position = sizeof(deny);
-        }
-#endif
-  } else if (request_code == COMMAND_SET_DATASET) {
-    int dataset_list_index = -1;
-
-    for (int i = 0; i < num_of_tokens; i++) {
-      if (memcmp(*recv_data + jsonhelper_get_token_start(i), "dataset_list", strlen("dataset_list")) == 0) {
-        dataset_list_index = i;
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, ctx->unix_path, sizeof(addr.sun_path) - 1);
+  // Remove a socket file left behind by a previous run.
+  unlink(ctx->unix_path);
+
+  if (bind(ctx->unix_listenfd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(ctx->unix_listenfd, ctx->listen_backlog) != 0) {
+    close(ctx->unix_listenfd);
+    ctx->unix_listenfd = -1;
+    return -1;
+  }
+
+  fcntl(ctx->unix_listenfd, F_SETFL, fcntl(ctx->unix_listenfd, F_GETFL, 0) | O_NONBLOCK);
+
+  struct epoll_event ev = {0};
+  ev.events = EPOLLIN;
+  ev.data.ptr = &ctx->unix_listenfd;
+  if (epoll_ctl(ctx->epollfd, EPOLL_CTL_ADD, ctx->unix_listenfd, &ev) != 0) {
+    close(ctx->unix_listenfd);
+    unlink(ctx->unix_path);
+    ctx->unix_listenfd = -1;
+    return -1;
+  }
+
+  log_info(network_logger_id, "[%s:%d] listening on %s.\n", __func__, __LINE__, ctx->unix_path);
+
+  return 0;
+}
+
+static long long get_time_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static const char g_grant[] = "{\"response\":\"access granted\"}";
+static const char g_deny[] = "{\"response\":\"access denied \"}";
+static const char g_batch_head[] = "{\"response\":[";
+static const char g_batch_tail[] = "]}";
+static const char g_too_large[] = "{\"error\":\"response too large\"}";
+
+// Appends a reference to data, which must stay valid until the response is sent.
+static void response_add(network_response_t *resp, const void *data, size_t len) {
+  if (resp->iovcnt == NETWORK_RESPONSE_IOV_MAX) {
+    log_error(network_logger_id, "[%s:%d] too many response fragments.\n", __func__, __LINE__);
+    return;
+  }
+
+  resp->iov[resp->iovcnt].iov_base = (void *)data;
+  resp->iov[resp->iovcnt].iov_len = len;
+  resp->iovcnt++;
+  resp->len += len;
+}
+
+// Fragments are only gathered when there is more than one, a single fragment goes to the auth layer as is.
+static void response_send(arena_t *arena, auth_ctx_t *auth, network_response_t *resp) {
+  char *msg = resp->buffer;
+
+  // A cut off reply would not parse on the client, so it is replaced rather than truncated.
+  if (resp->len > NETWORK_MAX_MESSAGE_LEN) {
+    log_error(network_logger_id, "[%s:%d] response of %zu bytes dropped.\n", __func__, __LINE__, resp->len);
+    resp->iovcnt = 0;
+    resp->len = 0;
+    response_add(resp, g_too_large, strlen(g_too_large));
+  }
+
+  if (resp->iovcnt == 1) {
+    msg = resp->iov[0].iov_base;
+  } else if (resp->iovcnt > 1) {
+    char *gather = arena_alloc(arena, resp->len);
+    if (gather == NULL) {
+      return;
+    }
+
+    size_t position = 0;
+    for (int i = 0; i < resp->iovcnt && position < resp->len; i++) {
+      size_t len = MIN(resp->iov[i].iov_len, resp->len - position);
+      memcpy(gather + position, resp->iov[i].iov_base, len);
+      position += len;
+    }
+    msg = gather;
+  }
+
+  auth_helper_send_decision(resp->len, auth, msg, resp->len);
+}
+
+static unsigned int copy_field(const network_request_t *req, const network_slice_t *field, char *out, int out_len) {
+  int len = MIN(field->len, out_len - 1);
+
+  if (len > 0) {
+    memcpy(out, req->data + field->start, len);
+  } else {
+    len = 0;
+  }
+  out[len] = '\0';
+
+  return len;
+}
+
+// Set in a resolve result next to the decision when the PEP ran an action or obligation for it.
+#define NETWORK_RESOLVE_ENFORCED 0x2
+#define NETWORK_RESOLVE_DECISION 0x1
+
+typedef struct {
+  network_ctx_internal_t *ctx;
+  char *request;
+} network_resolve_t;
+
+static int resolve_policy(network_ctx_internal_t *ctx, char *request) {
+  char decision[BUF_LEN] = {0};
+  unsigned actions = ctx->action_count_cb != NULL ? ctx->action_count_cb() : 0;
+
+  //@TODO: Should this be moved to access actor? Network should just send cb here to notify request.
+  pep_request_access(request, (void *)decision);
+
+  int result = memcmp(decision, "grant", strlen("grant")) != 0;
+  if (ctx->action_count_cb == NULL || ctx->action_count_cb() != actions) {
+    result |= NETWORK_RESOLVE_ENFORCED;
+  }
+
+  return result;
+}
+
+static int resolve_job(void *arg) {
+  network_resolve_t *resolve = (network_resolve_t *)arg;
+  return resolve_policy(resolve->ctx, resolve->request);
+}
+
+// Phones that come into range together resolve the same policy at the same moment, so concurrent
+// identical resolves share a single PDP evaluation and its PIP lookups, and repeated ones are
+// answered from the decision cache until a policy or dataset changes or the TTL runs out. The key
+// is the whole request, as every field of it can be an attribute of the policy; requests of
+// DECISIONCACHE_KEY_LEN bytes or more are always evaluated.
+// The PEP runs a granted action within the same call as the evaluation. A requester whose shared
+// result came with an action evaluates again, so it gets its own action and obligations, and such
+// results are never cached.
+static int resolve_shared(network_ctx_internal_t *ctx, char *request) {
+  network_resolve_t resolve = {ctx, request};
+  int key_len = strlen(request);
+  unsigned version = 0;
+  int decision;
+  int result;
+
+  if (ctx->decision_cache != NULL) {
+    if (decisioncache_get(ctx->decision_cache, request, key_len, get_time_ms(), &decision) == 0) {
+      return decision;
+    }
+    version = decisioncache_version(ctx->decision_cache);
+  }
+
+  if (ctx->resolve_flight != NULL) {
+    int shared;
+
+    result = singleflight_do(ctx->resolve_flight, request, key_len, resolve_job, &resolve, &shared);
+    if (shared && (result & NETWORK_RESOLVE_ENFORCED)) {
+      result = resolve_policy(ctx, request);
+    }
+  } else {
+    result = resolve_policy(ctx, request);
+  }
+  decision = result & NETWORK_RESOLVE_DECISION;
+
+  if (ctx->decision_cache != NULL && !(result & NETWORK_RESOLVE_ENFORCED)) {
+    decisioncache_put(ctx->decision_cache, request, key_len, version, get_time_ms(), decision);
+  }
+
+  return decision;
+}
+
+static void cmd_resolve(network_ctx_internal_t *ctx, network_connection_t *conn, network_request_t *req,
+                        network_response_t *resp) {
+  if (resolve_shared(ctx, req->data)) {
+    response_add(resp, g_grant, sizeof(g_grant));
+  } else {
+    response_add(resp, g_deny, sizeof(g_deny));
+  }
+}
+
+// Rewrites a resolve_batch request into a single resolve request for one policy ID, keeping
+// every other field of the original request.
+static void build_resolve_request(network_request_t *req, const char *policy_id, int policy_id_len, char *out,
+                                  int out_len) {
+  const char *data = req->data;
+  int cmd_end = req->cmd.start + req->cmd.len;
+  int ids_end = req->policy_ids.start + req->policy_ids.len;
+  int data_len = strlen(data);
+
+  if (req->cmd.start < req->policy_ids.key_start) {
+    snprintf(out, out_len, "%.*sresolve%.*s\"policy_id\":\"%.*s\"%s", req->cmd.start, data,
+             req->policy_ids.key_start - cmd_end, data + cmd_end, policy_id_len, policy_id, data + ids_end);
+  } else {
+    snprintf(out, out_len, "%.*s\"policy_id\":\"%.*s\"%.*sresolve%s", req->policy_ids.key_start, data,
+             policy_id_len, policy_id, req->cmd.start - ids_end, data + ids_end, data + MIN(cmd_end, data_len));
+  }
+}
+
+// Only reports decisions, e.g. to show which policies a client could use. The PEP evaluates each
+// ID in a dry run, so no granted action or obligation is enforced for any of them.
+static void cmd_resolve_batch(network_ctx_internal_t *ctx, network_connection_t *conn, network_request_t *req,
+                              network_response_t *resp) {
+  jsmn_parser parser;
+  jsmntok_t ids[NETWORK_MAX_BATCH + 1];
+  int results[NETWORK_MAX_BATCH];
+  const char *ids_json = req->data + req->policy_ids.start;
+
+  if (ctx->dry_run_cb == NULL || req->policy_ids.type != JSMN_ARRAY) {
+    response_add(resp, g_deny, sizeof(g_deny));
+    return;
+  }
+
+  jsmn_init(&parser);
+  int num_of_tokens = jsmn_parse(&parser, ids_json, req->policy_ids.len, ids, NETWORK_MAX_BATCH + 1);
+  if (num_of_tokens < 1 || ids[0].type != JSMN_ARRAY || num_of_tokens != ids[0].size + 1) {
+    log_error(network_logger_id, "[%s:%d] policy_ids must be a flat array of at most %d IDs.\n", __func__, __LINE__,
+              NETWORK_MAX_BATCH);
+    response_add(resp, g_deny, sizeof(g_deny));
+    return;
+  }
+
+  int count = ids[0].size;
+  int request_len = strlen(req->data) + POL_ID_STR_LEN + BUF_LEN;
+  char *request = arena_alloc(&conn->arena, request_len);
+  if (request == NULL) {
+    response_add(resp, g_deny, sizeof(g_deny));
+    return;
+  }
+
+  ctx->dry_run_cb(1);
+  for (int i = 0; i < count; i++) {
+    jsmntok_t *id = &ids[i + 1];
+    int id_len = id->end - id->start;
+
+    results[i] = 0;
+    if (id->type != JSMN_STRING || id_len > POL_ID_STR_LEN) {
+      continue;
+    }
+
+    // Clients often ask for the same policy twice on one screen, evaluate it only once.
+    int j;
+    for (j = 0; j < i; j++) {
+      if ((ids[j + 1].end - ids[j + 1].start) == id_len &&
+          memcmp(ids_json + ids[j + 1].start, ids_json + id->start, id_len) == 0) {
         break;
       }
     }
 
-    int arr_start = dataset_list_index + 1;
-
-    if ((dataset_list_index == -1) || (jsonhelper_get_token_at(arr_start).type != JSMN_ARRAY)) {
-      memcpy(ctx->send_buffer, deny, strlen(deny));
-      buffer_position = strlen(deny);
+    if (j < i) {
+      results[i] = results[j];
     } else {
-      pip_set_dataset(*recv_data + jsonhelper_get_token_at(arr_start).start,
-                      jsonhelper_get_token_at(arr_start).end - jsonhelper_get_token_at(arr_start).start);
-      memcpy(ctx->send_buffer, grant, strlen(grant));
-      buffer_position = strlen(grant);
-    }
-    *recv_data = ctx->send_buffer;
-  } else if (request_code == COMMAND_GET_DATASET) {
-    pip_get_dataset((char *)ctx->send_buffer, &buffer_position);
-    *recv_data = ctx->send_buffer;
-  } else if (request_code == COMMAND_GET_USER_OBJ) {
-    char username[USERNAME_LEN] = "";
-
-    for (int i = 0; i < num_of_tokens; i++) {
-      if (memcmp(*recv_data + jsonhelper_get_token_start(i), "username", strlen("username")) == 0) {
-        strncpy(username, *recv_data + jsonhelper_get_token_start(i + 1), jsonhelper_token_size(i + 1));
-        username[jsonhelper_token_size(i + 1)] = '\0';
-        break;
+      build_resolve_request(req, ids_json + id->start, id_len, request, request_len);
+      results[i] = resolve_shared(ctx, request);
+    }
+  }
+  ctx->dry_run_cb(0);
+
+  unsigned int buffer_position = 0;
+  for (int i = 0; i < count; i++) {
+    buffer_position += snprintf(resp->buffer + buffer_position, SEND_BUFF_LEN - buffer_position, i ? ",%d" : "%d",
+                                results[i]);
+  }
+
+  response_add(resp, g_batch_head, strlen(g_batch_head));
+  response_add(resp, resp->buffer, buffer_position);
+  response_add(resp, g_batch_tail, strlen(g_batch_tail));
+}
+
+// Renders into NETWORK_RENDER_LEN bytes and returns the length of the output, or -1 if it did not fit.
+typedef int (*network_render_t)(network_request_t *req, char *out);
+
+// Output of the SDK is only used when it ends within the buffer. Anything longer is refused, as a
+// reply cut at the buffer end would not parse.
+static int rendered_len(const char *out) {
+  const char *end = memchr(out, '\0', NETWORK_RENDER_LEN);
+
+  return end != NULL ? end - out : -1;
+}
+
+static void response_add_rendered(network_response_t *resp, int len) {
+  if (len < 0) {
+    log_error(network_logger_id, "[%s:%d] response does not fit in %d bytes.\n", __func__, __LINE__,
+              NETWORK_RENDER_LEN);
+    response_add(resp, g_too_large, strlen(g_too_large));
+    return;
+  }
+
+  response_add(resp, resp->buffer, len);
+}
+
+static int field_int(const network_request_t *req, const network_slice_t *field, int default_value) {
+  char number[BUF_LEN];
+
+  if (field->len <= 0 || field->type != JSMN_PRIMITIVE) {
+    return default_value;
+  }
+
+  copy_field(req, field, number, BUF_LEN);
+  return atoi(number);
+}
+
+static void stream_reset(network_stream_t *stream) {
+  free(stream->data);
+  free(stream->bounds);
+  memset(stream, 0, sizeof(network_stream_t));
+}
+
+// Renders the full result once and records where each element of its first array starts and ends,
+// later pages are then cut from this snapshot without running the command again.
+static int stream_open(arena_t *arena, network_stream_t *stream, int command, network_request_t *req,
+                       network_render_t render) {
+  jsmn_parser parser;
+  jsmntok_t *tokens = NULL;
+  int arr_index = -1;
+
+  stream->data = calloc(NETWORK_RENDER_LEN, 1);
+  if (stream->data == NULL) {
+    return -1;
+  }
+
+  int data_len = render(req, stream->data);
+  if (data_len < 0) {
+    log_error(network_logger_id, "[%s:%d] result does not fit in %d bytes.\n", __func__, __LINE__, NETWORK_RENDER_LEN);
+    stream_reset(stream);
+    return -1;
+  }
+  stream->command = command;
+
+  jsmn_init(&parser);
+  int num_of_tokens = jsmn_parse(&parser, stream->data, data_len, NULL, 0);
+  if (num_of_tokens < 1) {
+    stream_reset(stream);
+    return -1;
+  }
+
+  tokens = arena_alloc(arena, num_of_tokens * sizeof(jsmntok_t));
+  stream->bounds = malloc(num_of_tokens * 2 * sizeof(int));
+  if (tokens == NULL || stream->bounds == NULL) {
+    stream_reset(stream);
+    return -1;
+  }
+
+  jsmn_init(&parser);
+  jsmn_parse(&parser, stream->data, data_len, tokens, num_of_tokens);
+
+  for (int i = 0; i < num_of_tokens; i++) {
+    if (tokens[i].type == JSMN_ARRAY) {
+      arr_index = i;
+      break;
+    }
+  }
+
+  if (arr_index == -1) {
+    stream_reset(stream);
+    return -1;
+  }
+
+  // Direct children are the tokens that start after the previous child has ended.
+  int child_end = tokens[arr_index].start;
+  for (int i = arr_index + 1; i < num_of_tokens && tokens[i].start < tokens[arr_index].end; i++) {
+    if (tokens[i].start >= child_end) {
+      int start = tokens[i].start;
+      int end = tokens[i].end;
+
+      // Keep the quotes around string elements.
+      if (tokens[i].type == JSMN_STRING) {
+        start--;
+        end++;
+      }
+      stream->bounds[2 * stream->count] = start;
+      stream->bounds[2 * stream->count + 1] = end;
+      stream->count++;
+      child_end = end;
+    }
+  }
+
+  return 0;
+}
+
+static void stream_page(network_connection_t *conn, network_request_t *req, network_response_t *resp, int command,
+                        network_render_t render) {
+  network_stream_t *stream = &conn->session->stream;
+  int cursor = field_int(req, &req->cursor, 0);
+  int limit = field_int(req, &req->limit, NETWORK_STREAM_DEFAULT_LIMIT);
+
+  limit = MAX(1, MIN(limit, NETWORK_STREAM_MAX_LIMIT));
+
+  if (stream->data == NULL || stream->command != command || cursor == 0) {
+    stream_reset(stream);
+    if (stream_open(&conn->arena, stream, command, req, render) != 0) {
+      response_add(resp, g_deny, sizeof(g_deny));
+      return;
+    }
+  }
+
+  if (cursor < 0 || cursor > stream->count) {
+    cursor = stream->count;
+  }
+
+  // Leave room for the closing part of the page.
+  int space = SEND_BUFF_LEN - BUF_LEN;
+  int position = snprintf(resp->buffer, space, "{\"response\":[");
+  int next = cursor;
+
+  while (next < stream->count && next - cursor < limit) {
+    int start = stream->bounds[2 * next];
+    int len = stream->bounds[2 * next + 1] - start;
+
+    if (position + len + 1 > space) {
+      // A single element larger than a page is skipped rather than stalling the cursor.
+      if (next == cursor) {
+        log_error(network_logger_id, "[%s:%d] element %d does not fit in a page.\n", __func__, __LINE__, next);
+        next++;
+      }
+      break;
+    }
+
+    if (next > cursor) {
+      resp->buffer[position++] = ',';
+    }
+    memcpy(resp->buffer + position, stream->data + start, len);
+    position += len;
+    next++;
+  }
+
+  if (next < stream->count) {
+    position += snprintf(resp->buffer + position, SEND_BUFF_LEN - position, "],\"next_cursor\":%d}", next);
+  } else {
+    position += snprintf(resp->buffer + position, SEND_BUFF_LEN - position, "]}");
+    stream_reset(stream);
+  }
+
+  response_add(resp, resp->buffer, position);
+}
+
+static int render_policy_list(network_request_t *req, char *out) {
+  //@TODO: Should this be moved to access actor? Network should just send cb here to notify request.
+  pep_request_access(req->data, (void *)out);
+  return rendered_len(out);
+}
+
+static int render_dataset(network_request_t *req, char *out) {
+  unsigned int len = 0;
+
+  pip_get_dataset(out, &len);
+  if (len >= NETWORK_RENDER_LEN) {
+    return -1;
+  }
+  out[len] = '\0';
+
+  return len;
+}
+
+static int render_all_users(network_request_t *req, char *out) {
+  pap_user_management_action(PAP_USERMNG_GET_ALL_USR, out);
+  return rendered_len(out);
+}
+
+static void cmd_get_policy_list(network_ctx_internal_t *ctx, network_connection_t *conn, network_request_t *req,
+                                network_response_t *resp) {
+  if (req->cursor.len >= 0) {
+    stream_page(conn, req, resp, COMMAND_GET_POL_LIST, render_policy_list);
+    return;
+  }
+
+  response_add_rendered(resp, render_policy_list(req, resp->buffer));
+}
+
+static void cmd_enable_policy(network_ctx_internal_t *ctx, network_connection_t *conn, network_request_t *req,
+                              network_response_t *resp) {
+  //@FIXME: Will be refactored, policies are enabled by the policy loader for now.
+}
+
+static void cmd_set_dataset(network_ctx_internal_t *ctx, network_connection_t *conn, network_request_t *req,
+                            network_response_t *resp) {
+  if (req->dataset_list.len < 0 || req->dataset_list.type != JSMN_ARRAY) {
+    response_add(resp, g_deny, sizeof(g_deny));
+    return;
+  }
+
+  pip_set_dataset(req->data + req->dataset_list.start, req->dataset_list.len);
+  network_invalidate_decisions(ctx);
+  response_add(resp, g_grant, sizeof(g_grant));
+}
+
+static void cmd_get_dataset(network_ctx_internal_t *ctx, network_connection_t *conn, network_request_t *req,
+                            network_response_t *resp) {
+  if (req->cursor.len >= 0) {
+    stream_page(conn, req, resp, COMMAND_GET_DATASET, render_dataset);
+    return;
+  }
+
+  response_add_rendered(resp, render_dataset(req, resp->buffer));
+}
+
+static void cmd_get_user_obj(network_ctx_internal_t *ctx, network_connection_t *conn, network_request_t *req,
+                             network_response_t *resp) {
+  char username[USERNAME_LEN];
+
+  copy_field(req, &req->username, username, USERNAME_LEN);
+
+  log_info(network_logger_id, "[%s:%d] get user\n", __func__, __LINE__);
+  pap_user_management_action(PAP_USERMNG_GET_USER, username, resp->buffer);
+  response_add_rendered(resp, rendered_len(resp->buffer));
+}
+
+static void cmd_get_userid(network_ctx_internal_t *ctx, network_connection_t *conn, network_request_t *req,
+                           network_response_t *resp) {
+  char username[USERNAME_LEN];
+
+  copy_field(req, &req->username, username, USERNAME_LEN);
+
+  log_info(network_logger_id, "[%s:%d] get auth id\n", __func__, __LINE__);
+  pap_user_management_action(PAP_USERMNG_GET_USER_ID, username, resp->buffer);
+  response_add_rendered(resp, rendered_len(resp->buffer));
+}
+
+static void cmd_register_user(network_ctx_internal_t *ctx, network_connection_t *conn, network_request_t *req,
+                              network_response_t *resp) {
+  char user_data[USER_DATA_LEN];
+
+  copy_field(req, &req->user, user_data, USER_DATA_LEN);
+
+  log_info(network_logger_id, "[%s:%d] put user\n", __func__, __LINE__);
+  pap_user_management_action(PAP_USERMNG_PUT_USER, user_data, resp->buffer);
+  response_add_rendered(resp, rendered_len(resp->buffer));
+}
+
+static void cmd_get_all_user(network_ctx_internal_t *ctx, network_connection_t *conn, network_request_t *req,
+                             network_response_t *resp) {
+  log_info(network_logger_id, "[%s:%d] get all users\n", __func__, __LINE__);
+
+  if (req->cursor.len >= 0) {
+    stream_page(conn, req, resp, COMMAND_GET_ALL_USER, render_all_users);
+    return;
+  }
+
+  response_add_rendered(resp, render_all_users(req, resp->buffer));
+}
+
+static void cmd_clear_all_user(network_ctx_internal_t *ctx, network_connection_t *conn, network_request_t *req,
+                               network_response_t *resp) {
+  log_info(network_logger_id, "[%s:%d] clear all users\n", __func__, __LINE__);
+  pap_user_management_action(PAP_USERMNG_CLR_ALL_USR, resp->buffer);
+  response_add_rendered(resp, rendered_len(resp->buffer));
+}
+
+// A client that paid for a policy pushes the transaction hash, so the payment state is checked once
+// right away instead of waiting for the next round of the wallet confirmation service. Only a client
+// the policy would grant once paid can report a payment for it. That is evaluated in a dry run with
+// the policy taken as paid, as a policy gated on payment denies until then, and no action runs for
+// a request that only reports a payment. The callback then checks the transaction itself.
+static void cmd_notify_transaction(network_ctx_internal_t *ctx, network_connection_t *conn, network_request_t *req,
+                                   network_response_t *resp) {
+  char policy_id[POL_ID_STR_LEN + 1];
+  char transaction_hash[NETWORK_TX_HASH_LEN + 1];
+  int len;
+
+  if (ctx->transaction_cb == NULL || ctx->assume_paid_cb == NULL || ctx->dry_run_cb == NULL ||
+      req->policy_id.type != JSMN_STRING || req->policy_id.len > POL_ID_STR_LEN ||
+      req->transaction_hash.type != JSMN_STRING || req->transaction_hash.len != NETWORK_TX_HASH_LEN) {
+    response_add(resp, g_deny, sizeof(g_deny));
+    return;
+  }
+
+  ctx->dry_run_cb(1);
+  ctx->assume_paid_cb(1);
+  int decision = resolve_policy(ctx, req->data) & NETWORK_RESOLVE_DECISION;
+  ctx->assume_paid_cb(0);
+  ctx->dry_run_cb(0);
+
+  if (!decision) {
+    response_add(resp, g_deny, sizeof(g_deny));
+    return;
+  }
+
+  copy_field(req, &req->policy_id, policy_id, sizeof(policy_id));
+  copy_field(req, &req->transaction_hash, transaction_hash, sizeof(transaction_hash));
+
+  int status = ctx->transaction_cb(ctx->transaction_cb_data, policy_id, transaction_hash);
+  if (status < 0) {
+    log_error(network_logger_id, "[%s:%d] transaction check for policy %s failed.\n", __func__, __LINE__, policy_id);
+    response_add(resp, g_deny, sizeof(g_deny));
+    return;
+  }
+
+  // A confirmed payment changes isPayed, so decisions cached for the unpaid state are dropped.
+  if (status == 1) {
+    network_invalidate_decisions(ctx);
+  }
+
+  len = snprintf(resp->buffer, SEND_BUFF_LEN, "{\"response\":\"%s\"}", status == 1 ? "verified" : "paid");
+  response_add(resp, resp->buffer, len);
+}
+
+// Indexed by request code. The name is matched on "cmd" and is also the "cmd" written when a
+// binary request is turned into JSON for the SDK.
+static const network_command_t g_command_table[COMMAND_COUNT] = {
+    [COMMAND_RESOLVE] = {"resolve", cmd_resolve, NETWORK_LANE_DECISION},
+    [COMMAND_GET_POL_LIST] = {"get_policy_list", cmd_get_policy_list, NETWORK_LANE_DATASET},
+    [COMMAND_ENABLE_POLICY] = {"enable_policy", cmd_enable_policy, NETWORK_LANE_DATASET},
+    [COMMAND_SET_DATASET] = {"set_dataset", cmd_set_dataset, NETWORK_LANE_DATASET},
+    [COMMAND_GET_DATASET] = {"get_dataset", cmd_get_dataset, NETWORK_LANE_DATASET},
+    [COMMAND_GET_USER_OBJ] = {"get_user", cmd_get_user_obj, NETWORK_LANE_ADMIN},
+    [COMMAND_GET_USERID] = {"get_auth_user_id", cmd_get_userid, NETWORK_LANE_ADMIN},
+    [COMMAND_REDISTER_USER] = {"register_user", cmd_register_user, NETWORK_LANE_ADMIN},
+    [COMMAND_GET_ALL_USER] = {"get_all_users", cmd_get_all_user, NETWORK_LANE_ADMIN},
+    [COMMAND_CLEAR_ALL_USER] = {"clear_all_users", cmd_clear_all_user, NETWORK_LANE_ADMIN},
+    [COMMAND_NOTIFY_TRANSACTION] = {"notify_transaction", cmd_notify_transaction, NETWORK_LANE_DECISION},
+    [COMMAND_RESOLVE_BATCH] = {"resolve_batch", cmd_resolve_batch, NETWORK_LANE_DECISION},
+};
+
+// The position of a field is its tag in binary requests, new fields must be appended.
+static const network_field_t g_request_fields[] = {
+    {"cmd", offsetof(network_request_t, cmd)},
+    {"policy_id", offsetof(network_request_t, policy_id)},
+    {"user_id", offsetof(network_request_t, user_id)},
+    {"username", offsetof(network_request_t, username)},
+    {"user", offsetof(network_request_t, user)},
+    {"dataset_list", offsetof(network_request_t, dataset_list)},
+    {"policy_ids", offsetof(network_request_t, policy_ids)},
+    {"cursor", offsetof(network_request_t, cursor)},
+    {"limit", offsetof(network_request_t, limit)},
+    {"transaction_hash", offsetof(network_request_t, transaction_hash)},
+};
+
+static int lookup_command(network_request_t *req) {
+  if (req->cmd.len > 0) {
+    for (int code = 0; code < COMMAND_COUNT; code++) {
+      const char *name = g_command_table[code].name;
+
+      if (name != NULL && strlen(name) == req->cmd.len && memcmp(req->data + req->cmd.start, name, req->cmd.len) == 0) {
+        return code;
       }
     }
+  }
+
+  // Requests the table does not know are left to the SDK, which may recognize other spellings.
+  pthread_mutex_lock(&g_json_lock);
+  int request_code = auth_helper_check_msg_format(req->data);
+  pthread_mutex_unlock(&g_json_lock);
+
+  return request_code;
+}
 
-    log_info(network_logger_id, "[%s:%d] get user\n", __func__, __LINE__);
-    pap_user_management_action(PAP_USERMNG_GET_USER, username, ctx->send_buffer);
-    *recv_data = ctx->send_buffer;
-    buffer_position = strlen(ctx->send_buffer);
-  } else if (request_code == COMMAND_GET_USERID) {
-    char username[USERNAME_LEN] = "";
+// Returns the request code, or -1 if the message is not a valid request. The tokens go to the
+// parser of the connection, so workers parse requests of different connections in parallel.
+static int parse_request(jsonparser_ctx_t *parser, char *recv_data, network_request_t *req) {
+  int num_of_fields = sizeof(g_request_fields) / sizeof(g_request_fields[0]);
+
+  req->data = recv_data;
+  for (int f = 0; f < num_of_fields; f++) {
+    network_slice_t *slice = (network_slice_t *)((char *)req + g_request_fields[f].offset);
+    slice->start = 0;
+    slice->len = -1;
+    slice->type = JSMN_UNDEFINED;
+  }
+
+  int num_of_tokens = jsonparser_parse(parser, recv_data, strlen(recv_data));
+  jsmntok_t *root = jsonparser_token(parser, 0);
+  if (root == NULL || root->type != JSMN_OBJECT) {
+    return -1;
+  }
 
-    for (int i = 0; i < num_of_tokens; i++) {
-      if (memcmp(*recv_data + jsonhelper_get_token_start(i), "username", strlen("username")) == 0) {
-        strncpy(username, *recv_data + jsonhelper_get_token_start(i + 1), jsonhelper_token_size(i + 1));
-        username[jsonhelper_token_size(i + 1)] = '\0';
+  // Single pass over the keys of the top-level object. Each value is skipped with everything nested
+  // in it, so a key inside a value, e.g. within user, never captures a field.
+  int num_of_keys = root->size;
+  int i = 1;
+  for (int k = 0; k < num_of_keys && i < num_of_tokens - 1; k++) {
+    jsmntok_t key = *jsonparser_token(parser, i);
+
+    for (int f = 0; f < num_of_fields && key.type == JSMN_STRING; f++) {
+      network_slice_t *slice = (network_slice_t *)((char *)req + g_request_fields[f].offset);
+
+      if (slice->len < 0 && (key.end - key.start) == strlen(g_request_fields[f].key) &&
+          memcmp(recv_data + key.start, g_request_fields[f].key, key.end - key.start) == 0) {
+        jsmntok_t *value = jsonparser_token(parser, i + 1);
+        slice->key_start = key.start - 1;
+        slice->start = value->start;
+        slice->len = value->end - value->start;
+        slice->type = value->type;
         break;
       }
     }
 
-    log_info(network_logger_id, "[%s:%d] get auth id\n", __func__, __LINE__);
-    pap_user_management_action(PAP_USERMNG_GET_USER_ID, username, ctx->send_buffer);
-    *recv_data = ctx->send_buffer;
-    buffer_position = strlen(ctx->send_buffer);
-  } else if (request_code == COMMAND_REDISTER_USER) {
-    char user_data[USER_DATA_LEN];
-    for (int i = 0; i < num_of_tokens; i++) {
-      if (memcmp(*recv_data + jsonhelper_get_token_start(i), "user", strlen("user")) == 0) {
-        strncpy(user_data, *recv_data + jsonhelper_get_token_start(i + 1), jsonhelper_token_size(i + 1));
-        user_data[jsonhelper_token_size(i + 1)] = '\0';
+    i = jsonparser_skip(parser, i + 1);
+  }
+
+  return lookup_command(req);
+}
+
+static int binary_string_valid(const char *value, int len) {
+  for (int i = 0; i < len; i++) {
+    if (value[i] == '"' || value[i] == '\\' || (unsigned char)value[i] < ' ') {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static int binary_primitive_valid(const char *value, int len) {
+  if ((len == 4 && (memcmp(value, "true", 4) == 0 || memcmp(value, "null", 4) == 0)) ||
+      (len == 5 && memcmp(value, "false", 5) == 0)) {
+    return 1;
+  }
+
+  for (int i = 0; i < len; i++) {
+    if ((value[i] < '0' || value[i] > '9') && strchr("+-.eE", value[i]) == NULL) {
+      return 0;
+    }
+  }
+
+  return len > 0;
+}
+
+// A value without the string flag is copied into the rebuilt request as JSON text, so it must be
+// exactly one array, object, number or literal. Anything else, e.g. a value that closes the
+// request early, could add keys to it. Returns the type of the value, or JSMN_UNDEFINED.
+static jsmntype_t binary_value_type(jsonparser_ctx_t *parser, const char *value, int len) {
+  int num_of_tokens = jsonparser_parse(parser, value, len);
+  jsmntok_t *root = jsonparser_token(parser, 0);
+
+  if (root == NULL || root->type == JSMN_STRING || root->start != 0 || root->end != len ||
+      jsonparser_skip(parser, 0) != num_of_tokens) {
+    return JSMN_UNDEFINED;
+  }
+
+  // The tokenizer accepts bare words as primitives, also within arrays and objects.
+  for (int i = 0; i < num_of_tokens; i++) {
+    jsmntok_t *tok = jsonparser_token(parser, i);
+
+    if (tok->type == JSMN_PRIMITIVE && !binary_primitive_valid(value + tok->start, tok->end - tok->start)) {
+      return JSMN_UNDEFINED;
+    }
+  }
+
+  return root->type;
+}
+
+// Binary requests carry the command code and the fields as TLVs, so they need no tokenizing:
+//   byte 0   NETWORK_BINARY_MAGIC, which never starts a JSON request
+//   byte 1   request code
+//   fields   tag (1 byte), value length (2 bytes, big endian), value
+// The tag is the index of the field in g_request_fields, with NETWORK_BINARY_STRING set when the
+// value is a plain string. Other values are JSON text, e.g. the dataset_list array, and are
+// checked with parser. The request is rebuilt as JSON in json, so handlers and the SDK see the
+// same request as for a JSON client.
+// Returns the request code, or -1 if the message is not a valid request.
+static int parse_binary_request(jsonparser_ctx_t *parser, const char *msg, int msg_len, network_request_t *req,
+                                char *json, int json_len) {
+  const unsigned char *in = (const unsigned char *)msg;
+  int num_of_fields = sizeof(g_request_fields) / sizeof(g_request_fields[0]);
+  int request_code = in[1];
+  int msg_position = NETWORK_BINARY_HEADER_LEN;
+  int json_position;
+
+  if (request_code >= COMMAND_COUNT || g_command_table[request_code].handler == NULL) {
+    return -1;
+  }
+
+  for (int f = 0; f < num_of_fields; f++) {
+    network_slice_t *slice = (network_slice_t *)((char *)req + g_request_fields[f].offset);
+    slice->start = 0;
+    slice->len = -1;
+    slice->type = JSMN_UNDEFINED;
+  }
+
+  const char *name = g_command_table[request_code].name;
+  json_position = snprintf(json, json_len, "{\"cmd\":\"%s\"", name);
+  req->data = json;
+  req->cmd.key_start = 1;
+  req->cmd.start = json_position - strlen(name) - 1;
+  req->cmd.len = strlen(name);
+  req->cmd.type = JSMN_STRING;
+
+  while (msg_position + NETWORK_BINARY_TLV_HEADER_LEN <= msg_len) {
+    int tag = in[msg_position] & NETWORK_BINARY_TAG_MASK;
+    int is_string = in[msg_position] & NETWORK_BINARY_STRING;
+    int len = (in[msg_position + 1] << 8) | in[msg_position + 2];
+    const char *value = msg + msg_position + NETWORK_BINARY_TLV_HEADER_LEN;
+
+    msg_position += NETWORK_BINARY_TLV_HEADER_LEN + len;
+    if (msg_position > msg_len || tag == 0 || tag >= num_of_fields) {
+      return -1;
+    }
+
+    jsmntype_t type = JSMN_STRING;
+    if (is_string ? !binary_string_valid(value, len) : (type = binary_value_type(parser, value, len)) == JSMN_UNDEFINED) {
+      return -1;
+    }
+
+    network_slice_t *slice = (network_slice_t *)((char *)req + g_request_fields[tag].offset);
+    const char *key = g_request_fields[tag].key;
+    if (slice->len >= 0 || json_position + (int)strlen(key) + len + NETWORK_BINARY_FIELD_OVERHEAD >= json_len) {
+      return -1;
+    }
+
+    slice->key_start = json_position + 1;
+    json_position += sprintf(json + json_position, is_string ? ",\"%s\":\"" : ",\"%s\":", key);
+    slice->start = json_position;
+    slice->len = len;
+    memcpy(json + json_position, value, len);
+    json_position += len;
+
+    slice->type = type;
+    if (is_string) {
+      json[json_position++] = '"';
+    }
+  }
+
+  if (msg_position != msg_len) {
+    return -1;
+  }
+
+  json[json_position++] = '}';
+  json[json_position] = '\0';
+
+  return request_code;
+}
+
+// Picks the lane of a received request before it is queued again. This runs on the worker that
+// read the request, and only looks for the command name; the worker running the request parses it
+// fully.
+static network_lane_e classify_request(network_connection_t *conn) {
+  const char *data = conn->recv_data;
+  const char *name = NULL;
+  int name_len = 0;
+
+  if (conn->recv_len >= NETWORK_BINARY_HEADER_LEN && (unsigned char)data[0] == NETWORK_BINARY_MAGIC) {
+    int code = (unsigned char)data[1];
+    return code < COMMAND_COUNT && g_command_table[code].handler != NULL ? g_command_table[code].lane
+                                                                          : NETWORK_LANE_ADMIN;
+  }
+
+  const char *key = strstr(data, "\"cmd\"");
+  if (key != NULL) {
+    name = key + strlen("\"cmd\"");
+    while (*name == ' ' || *name == ':' || *name == '\t' || *name == '\r' || *name == '\n') {
+      name++;
+    }
+    if (*name == '"') {
+      name++;
+      while (name[name_len] != '"' && name[name_len] != '\0') {
+        name_len++;
+      }
+    }
+  }
+
+  for (int code = 0; code < COMMAND_COUNT && name_len > 0; code++) {
+    const char *command = g_command_table[code].name;
+
+    if (command != NULL && strlen(command) == name_len && memcmp(name, command, name_len) == 0) {
+      return g_command_table[code].lane;
+    }
+  }
+
+  return NETWORK_LANE_ADMIN;
+}
+
+static void dispatch_request(network_ctx_internal_t *ctx, network_connection_t *conn, network_response_t *resp) {
+  network_request_t req;
+  char *json = NULL;
+  int request_code;
+
+  if (conn->recv_len >= NETWORK_BINARY_HEADER_LEN && (unsigned char)conn->recv_data[0] == NETWORK_BINARY_MAGIC) {
+    int json_len = NETWORK_BINARY_JSON_LEN(conn->recv_len);
+    jsmntok_t *tokens = arena_alloc(&conn->arena, NETWORK_MAX_TOKENS * sizeof(jsmntok_t));
+
+    json = arena_alloc(&conn->arena, json_len);
+    request_code = -1;
+    if (json != NULL && tokens != NULL) {
+      jsonparser_init(&conn->parser, tokens, NETWORK_MAX_TOKENS);
+      request_code = parse_binary_request(&conn->parser, conn->recv_data, conn->recv_len, &req, json, json_len);
+    }
+  } else {
+    jsmntok_t *tokens = arena_alloc(&conn->arena, NETWORK_MAX_TOKENS * sizeof(jsmntok_t));
+
+    request_code = -1;
+    if (tokens != NULL) {
+      jsonparser_init(&conn->parser, tokens, NETWORK_MAX_TOKENS);
+      request_code = parse_request(&conn->parser, conn->recv_data, &req);
+    }
+  }
+
+  if (request_code >= 0 && request_code < COMMAND_COUNT && g_command_table[request_code].handler != NULL) {
+    g_command_table[request_code].handler(ctx, conn, &req, resp);
+    return;
+  }
+
+  if (json != NULL) {
+    log_info(network_logger_id, "[%s:%d] binary request format not valid\n", __func__, __LINE__);
+    response_add(resp, g_deny, sizeof(g_deny));
+    return;
+  }
+
+  log_info(network_logger_id, "[%s:%d] request message format not valid\n > %s\n", __func__, __LINE__, conn->recv_data);
+  response_add(resp, g_deny, sizeof(g_deny));
+}
+
+static void session_release(network_session_t *session) {
+  if (session->has_auth) {
+    auth_release(&session->auth);
+  }
+  stream_reset(&session->stream);
+  free(session);
+}
+
+static void connection_close(network_ctx_internal_t *ctx, network_connection_t *conn) {
+  epoll_ctl(ctx->epollfd, EPOLL_CTL_DEL, conn->fd, NULL);
+
+  if (conn->session != NULL) {
+    network_session_t *session = conn->session;
+    conn->session = NULL;
+
+    if (session->request_count > 1) {
+      log_info(network_logger_id, "[%s:%d] session closed after %u requests.\n", __func__, __LINE__,
+               session->request_count);
+    }
+
+    session_release(session);
+  }
+
+  // Closed under the lock, so the deadline sweep never shuts down a descriptor number that was reused.
+  pthread_mutex_lock(&ctx->conn_lock);
+  close(conn->fd);
+  conn->fd = -1;
+  conn->state = NETWORK_CONN_FREE;
+  pthread_mutex_unlock(&ctx->conn_lock);
+}
+
+// Starts a phase. Its deadline covers the phase as a whole and is enforced by the loop only: a
+// per call socket timeout would restart on every byte, so a client trickling its handshake could
+// hold a worker indefinitely.
+static void connection_set_phase(network_ctx_internal_t *ctx, network_connection_t *conn, network_phase_e phase) {
+  pthread_mutex_lock(&ctx->conn_lock);
+  conn->phase = phase;
+  conn->deadline_ms = get_time_ms() + ctx->phase_timeout_ms[phase];
+  pthread_mutex_unlock(&ctx->conn_lock);
+}
+
+static void count_timeout(network_ctx_internal_t *ctx, network_phase_e phase) {
+  pthread_mutex_lock(&ctx->conn_lock);
+  unsigned long count = ++ctx->timeouts[phase];
+  pthread_mutex_unlock(&ctx->conn_lock);
+
+  log_info(network_logger_id, "[%s:%d] %s timeout, %lu so far.\n", __func__, __LINE__, g_phase_names[phase], count);
+}
+
+static int connection_rearm(network_ctx_internal_t *ctx, network_connection_t *conn) {
+  struct epoll_event ev = {0};
+  ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+  ev.data.ptr = conn;
+
+  return epoll_ctl(ctx->epollfd, EPOLL_CTL_MOD, conn->fd, &ev);
+}
+
+static int unix_peer_allowed(network_ctx_internal_t *ctx, int connfd) {
+  struct ucred cred;
+  socklen_t len = sizeof(cred);
+
+  if (ctx->unix_allowed_uid < 0) {
+    return 1;
+  }
+
+  if (getsockopt(connfd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0) {
+    return 0;
+  }
+
+  return cred.uid == (uid_t)ctx->unix_allowed_uid;
+}
+
+// Sent in plain text instead of starting the handshake, so the client can tell overload from
+// a network failure and back off for the given time.
+static void reject_busy(int connfd, int retry_after_ms) {
+  char busy[BUF_LEN];
+  int len = snprintf(busy, BUF_LEN, "{\"error\":\"busy\",\"retry_after_ms\":%d}", retry_after_ms);
+
+  send(connfd, busy, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+  close(connfd);
+}
+
+// Returns 0 if the connection may proceed, otherwise the number of milliseconds the client
+// should wait before retrying. The work queue is only refused once it is full, as new
+// clients would then time out behind the requests already waiting.
+static int admission_check(network_ctx_internal_t *ctx, struct sockaddr_in *peer, int is_tcp) {
+  int in_use = 0;
+
+  if (is_tcp && ctx->rate_limiter != NULL) {
+    int wait_ms = ratelimiter_allow(ctx->rate_limiter, peer->sin_addr.s_addr, get_time_ms());
+    if (wait_ms > 0) {
+      return wait_ms;
+    }
+  }
+
+  pthread_mutex_lock(&ctx->conn_lock);
+  for (int i = 0; i < NETWORK_MAX_CONNECTIONS; i++) {
+    if (ctx->connections[i].state != NETWORK_CONN_FREE) {
+      in_use++;
+    }
+  }
+  pthread_mutex_unlock(&ctx->conn_lock);
+
+  if (in_use >= ctx->max_connections || workerpool_pending(ctx->pool) >= ctx->queue_len) {
+    return ctx->busy_retry_ms;
+  }
+
+  return 0;
+}
+
+static void accept_connections(network_ctx_internal_t *ctx, int listenfd) {
+  while (1) {
+    struct sockaddr_in peer = {0};
+    socklen_t peer_len = sizeof(peer);
+    int connfd = accept(listenfd, (struct sockaddr *)&peer, &peer_len);
+    if (connfd < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        log_error(network_logger_id, "[%s:%d] accept failed.\n", __func__, __LINE__);
+      }
+      break;
+    }
+
+    if (listenfd == ctx->unix_listenfd && !unix_peer_allowed(ctx, connfd)) {
+      log_error(network_logger_id, "[%s:%d] local peer rejected.\n", __func__, __LINE__);
+      close(connfd);
+      continue;
+    }
+
+    int retry_after_ms = admission_check(ctx, &peer, listenfd == ctx->listenfd);
+    if (retry_after_ms > 0) {
+      log_info(network_logger_id, "[%s:%d] client rejected, retry after %d ms.\n", __func__, __LINE__, retry_after_ms);
+      reject_busy(connfd, retry_after_ms);
+      continue;
+    }
+
+    network_connection_t *conn = NULL;
+    pthread_mutex_lock(&ctx->conn_lock);
+    for (int i = 0; i < NETWORK_MAX_CONNECTIONS; i++) {
+      if (ctx->connections[i].state == NETWORK_CONN_FREE) {
+        conn = &ctx->connections[i];
+        conn->fd = connfd;
+        conn->state = NETWORK_CONN_ACCEPTED;
+        conn->session = NULL;
         break;
       }
     }
+    pthread_mutex_unlock(&ctx->conn_lock);
+
+    if (conn == NULL) {
+      log_error(network_logger_id, "[%s:%d] connection table full, dropping client.\n", __func__, __LINE__);
+      reject_busy(connfd, ctx->busy_retry_ms);
+      continue;
+    }
+
+    // The auth layer reads and writes synchronously on a worker, so a client that stalls mid
+    // exchange is cut off by the deadline sweep and never holds the event loop.
+    connection_set_phase(ctx, conn, NETWORK_PHASE_HELLO);
+
+    struct epoll_event ev = {0};
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    ev.data.ptr = conn;
+    if (epoll_ctl(ctx->epollfd, EPOLL_CTL_ADD, connfd, &ev) != 0) {
+      log_error(network_logger_id, "[%s:%d] epoll add connection failed.\n", __func__, __LINE__);
+      close(connfd);
+      pthread_mutex_lock(&ctx->conn_lock);
+      conn->fd = -1;
+      conn->state = NETWORK_CONN_FREE;
+      pthread_mutex_unlock(&ctx->conn_lock);
+      continue;
+    }
+
+    log_info(network_logger_id, "[%s:%d] Client connected.\n", __func__, __LINE__);
+  }
+}
+
+// Sent instead of an answer when the work queue has no room for the connection.
+static void connection_busy(network_ctx_internal_t *ctx, network_connection_t *conn) {
+  char busy[BUF_LEN];
+  int len = snprintf(busy, BUF_LEN, "{\"error\":\"busy\",\"retry_after_ms\":%d}", ctx->busy_retry_ms);
 
-    log_info(network_logger_id, "[%s:%d] put user\n", __func__, __LINE__);
-    pap_user_management_action(PAP_USERMNG_PUT_USER, user_data, ctx->send_buffer);
-    *recv_data = ctx->send_buffer;
-    buffer_position = strlen(ctx->send_buffer);
-  } else if (request_code == COMMAND_GET_ALL_USER) {
-    log_info(network_logger_id, "[%s:%d] get all users\n", __func__, __LINE__);
-    pap_user_management_action(PAP_USERMNG_GET_ALL_USR, ctx->send_buffer);
-    *recv_data = ctx->send_buffer;
-    buffer_position = strlen(ctx->send_buffer);
-  } else if (request_code == COMMAND_CLEAR_ALL_USER) {
-    log_info(network_logger_id, "[%s:%d] clear all users\n", __func__, __LINE__);
-    pap_user_management_action(PAP_USERMNG_CLR_ALL_USR, ctx->send_buffer);
-    *recv_data = ctx->send_buffer;
-    buffer_position = strlen(ctx->send_buffer);
+  log_error(network_logger_id, "[%s:%d] work queue full.\n", __func__, __LINE__);
+  if (conn->session != NULL) {
+    auth_helper_send_decision(len, &conn->session->auth, busy, len);
   } else {
-    log_info(network_logger_id, "[%s:%d] request message format not valid\n > %s\n", __func__, __LINE__, *recv_data);
-    memset(*recv_data, '0', sizeof(ctx->send_buffer));
-    memcpy(ctx->send_buffer, deny, sizeof(deny));
-    *recv_data = ctx->send_buffer;
-    buffer_position = sizeof(deny);
+    send(conn->fd, busy, len, MSG_DONTWAIT | MSG_NOSIGNAL);
   }
+  connection_close(ctx, conn);
+}
 
-  return buffer_position;
+// The deadline sweep and admission control read the state from the loop while a worker owns the
+// connection, so it is only written under conn_lock.
+static void connection_set_state(network_ctx_internal_t *ctx, network_connection_t *conn,
+                                 network_conn_state_e state) {
+  pthread_mutex_lock(&ctx->conn_lock);
+  conn->state = state;
+  pthread_mutex_unlock(&ctx->conn_lock);
 }
 
-static void *network_thread_function(void *ptr) {
-  network_ctx_internal_t *ctx = (network_ctx_internal_t *)ptr;
-  while (!ctx->end) {
-    struct timeval tv = {0, TIME_50MS};
-    int result;
-    fd_set rfds;
+// The connection stays disarmed until the worker is done with it.
+static void connection_submit(network_ctx_internal_t *ctx, network_connection_t *conn, network_task_e task,
+                              network_lane_e lane) {
+  conn->task = task;
+  connection_set_state(ctx, conn, NETWORK_CONN_BUSY);
+  if (workerpool_submit(ctx->pool, conn, lane) != 0) {
+    connection_busy(ctx, conn);
+  }
+}
+
+static void handle_connection(network_ctx_internal_t *ctx, network_connection_t *conn, uint32_t events) {
+  if (events & (EPOLLERR | EPOLLHUP)) {
+    connection_close(ctx, conn);
+    return;
+  }
+
+  // The handshake and the read block on the client, so they go to the client I/O lane, which never
+  // gets every worker. The request is queued again in its own lane once it is read.
+  if (conn->state == NETWORK_CONN_ACCEPTED) {
+    connection_set_phase(ctx, conn, NETWORK_PHASE_HANDSHAKE);
+    connection_submit(ctx, conn, NETWORK_TASK_HANDSHAKE, NETWORK_LANE_CLIENT_IO);
+  } else if (conn->state == NETWORK_CONN_AUTHENTICATED) {
+    if (conn->phase == NETWORK_PHASE_IDLE) {
+      connection_set_phase(ctx, conn, NETWORK_PHASE_REQUEST);
+    }
+    connection_submit(ctx, conn, NETWORK_TASK_RECEIVE, NETWORK_LANE_CLIENT_IO);
+  }
+}
+
+static void handshake_job(network_ctx_internal_t *ctx, network_connection_t *conn) {
+  conn->session = calloc(1, sizeof(network_session_t));
+  if (conn->session == NULL) {
+    connection_close(ctx, conn);
+    return;
+  }
+
+  conn->session->fd = conn->fd;
+  auth_init_server(&conn->session->auth, &conn->session->fd);
+  conn->session->has_auth = 1;
 
-    FD_ZERO(&rfds);
-    FD_SET(ctx->listenfd, &rfds);
+  if (auth_authenticate(&conn->session->auth) != 0) {
+    log_error(network_logger_id, "[%s:%d] Authentication failed.\n", __func__, __LINE__);
 
-    result = select(ctx->listenfd + 1, &rfds, (fd_set *)0, (fd_set *)0, &tv);
+    int size = 34;
+    tcpip_write_socket(&conn->fd, "{\"error\":\"authentication failed\"}", size);
+    connection_close(ctx, conn);
+    return;
+  }
 
-    if (0 < result) {
-      int ret, n = 0;
+  connection_set_phase(ctx, conn, NETWORK_PHASE_REQUEST);
+  connection_set_state(ctx, conn, NETWORK_CONN_AUTHENTICATED);
 
-      ctx->connfd = accept(ctx->listenfd, (struct sockaddr *)NULL, NULL);
+  if (!ctx->end && connection_rearm(ctx, conn) != 0) {
+    connection_close(ctx, conn);
+  }
+}
 
-      time_t now;
-      struct tm ts;
-      char buf[BUF_LEN];
+static void receive_job(network_ctx_internal_t *ctx, network_connection_t *conn) {
+  conn->recv_data = NULL;
+  conn->recv_len = 0;
 
-      // Get current time
-      time(&now);
+  if (auth_receive(&conn->session->auth, (unsigned char **)&conn->recv_data, &conn->recv_len) != 0 ||
+      conn->recv_data == NULL) {
+    connection_close(ctx, conn);
+    return;
+  }
 
-      // Format time, "ddd yyyy-mm-dd hh:mm:ss zzz"
-      ts = *localtime(&now);
-      strftime(buf, sizeof(buf), "%h:%M:%S", &ts);
+  connection_set_phase(ctx, conn, NETWORK_PHASE_RESPONSE);
+  conn->task = NETWORK_TASK_DISPATCH;
+  if (workerpool_submit(ctx->pool, conn, classify_request(conn)) != 0) {
+    free(conn->recv_data);
+    conn->recv_data = NULL;
+    connection_busy(ctx, conn);
+  }
+}
 
-      log_info(network_logger_id, "[%s:%d] Client connected.\n", __func__, __LINE__);
+// Frees the memory of the finished request in one step and reports a new high-water mark, which
+// is what request_arena_len should be sized to.
+static void arena_release_request(network_ctx_internal_t *ctx, network_connection_t *conn) {
+  size_t used = conn->arena.used;
 
-      // START
+  arena_reset(&conn->arena);
 
-      if ((ctx->state == 0)) {
-        ctx->state = 1;
-        char *recv_data = NULL;
-        unsigned short recv_len = 0;
-        int auth = -1;
-        int decision = -1;
+  pthread_mutex_lock(&ctx->conn_lock);
+  int is_new_max = used > ctx->arena_high_water;
+  if (is_new_max) {
+    ctx->arena_high_water = used;
+  }
+  pthread_mutex_unlock(&ctx->conn_lock);
 
-        auth_init_server(&ctx->session, &ctx->connfd);
+  if (is_new_max) {
+    log_info(network_logger_id, "[%s:%d] request arena high-water mark %zu bytes.\n", __func__, __LINE__, used);
+  }
+}
 
-        auth = auth_authenticate(&ctx->session);
+static void decision_job(network_ctx_internal_t *ctx, network_connection_t *conn, network_worker_t *worker) {
+  network_response_t resp = {0};
 
-        if (auth == 0) {
-          auth_receive(&ctx->session, (unsigned char **)&recv_data, &recv_len);
-          decision = calculate_decision(&recv_data, ctx);
-          auth_helper_send_decision(decision, &ctx->session, recv_data, decision);
-        } else {
-          time(&now);
+  resp.buffer = worker->send_buffer;
+  dispatch_request(ctx, conn, &resp);
+  response_send(&conn->arena, &conn->session->auth, &resp);
 
-          // Format time, "ddd yyyy-mm-dd hh:mm:ss zzz"
-          ts = *localtime(&now);
-          strftime(buf, sizeof(buf), "%h:%M:%S", &ts);
+  if (ctx->DAC_AUTH == 1) {
+    free(conn->recv_data);
+  }
+  conn->recv_data = NULL;
+  arena_release_request(ctx, conn);
+  conn->session->request_count++;
 
-          log_error(network_logger_id, "[%s:%d] Authentication failed.\n", __func__, __LINE__);
+  if (!ctx->session_mode) {
+    connection_close(ctx, conn);
+    return;
+  }
 
-          decision = 0;
-          int size = 34;
-          tcpip_write_socket(&ctx->connfd, "{\"error\":\"authentication failed\"}", size);
-        }
+  // Keep the authenticated session open for the next request on this connection.
+  connection_set_phase(ctx, conn, NETWORK_PHASE_IDLE);
+  connection_set_state(ctx, conn, NETWORK_CONN_AUTHENTICATED);
+  if (!ctx->end && connection_rearm(ctx, conn) != 0) {
+    connection_close(ctx, conn);
+  }
+}
 
-        ctx->state = 0;
+static void connection_job(void *job, int worker_idx, void *user_data) {
+  network_ctx_internal_t *ctx = (network_ctx_internal_t *)user_data;
+  network_connection_t *conn = (network_connection_t *)job;
 
-        auth_release(&ctx->session);
+  if (conn->task == NETWORK_TASK_HANDSHAKE) {
+    handshake_job(ctx, conn);
+  } else if (conn->task == NETWORK_TASK_RECEIVE) {
+    receive_job(ctx, conn);
+  } else {
+    decision_job(ctx, conn, &ctx->workers[worker_idx]);
+  }
+}
 
-        unsigned char try_count = 0;
-        while ((get_server_state(ctx) != 0) && (try_count++ < MAX_TRY_NUM))
-          ;
+// Connections waiting in the loop are closed once their phase is over. Connections owned by a
+// worker, including handshakes and reads in progress, are shut down instead, which fails the
+// blocked auth call however far the client got and lets the worker close them.
+static void enforce_deadlines(network_ctx_internal_t *ctx) {
+  long long now = get_time_ms();
+
+  for (int i = 0; i < NETWORK_MAX_CONNECTIONS; i++) {
+    network_connection_t *conn = &ctx->connections[i];
+    int expired = 0;
+
+    pthread_mutex_lock(&ctx->conn_lock);
+    network_phase_e phase = conn->phase;
+    if (conn->state != NETWORK_CONN_FREE && now > conn->deadline_ms) {
+      expired = 1;
+      if (conn->state == NETWORK_CONN_BUSY) {
+        shutdown(conn->fd, SHUT_RDWR);
+        conn->deadline_ms = LLONG_MAX;
       }
+    }
+    network_conn_state_e state = conn->state;
+    pthread_mutex_unlock(&ctx->conn_lock);
 
-      // END
+    if (!expired) {
+      continue;
+    }
 
-      close(ctx->connfd);
+    if (phase == NETWORK_PHASE_IDLE) {
+      log_info(network_logger_id, "[%s:%d] session idle timeout.\n", __func__, __LINE__);
+    } else {
+      count_timeout(ctx, phase);
     }
 
-    usleep(g_task_sleep_time);
+    if (state != NETWORK_CONN_BUSY) {
+      connection_close(ctx, conn);
+    }
   }
 }
+
+static void *network_thread_function(void *ptr) {
+  network_ctx_internal_t *ctx = (network_ctx_internal_t *)ptr;
+  struct epoll_event events[NETWORK_MAX_EVENTS];
+
+  while (!ctx->end) {
+    int n = epoll_wait(ctx->epollfd, events, NETWORK_MAX_EVENTS, NETWORK_EPOLL_TIMEOUT_MS);
+
+    for (int i = 0; i < n; i++) {
+      if (events[i].data.ptr == &ctx->listenfd) {
+        accept_connections(ctx, ctx->listenfd);
+      } else if (events[i].data.ptr == &ctx->unix_listenfd) {
+        accept_connections(ctx, ctx->unix_listenfd);
+      } else {
+        handle_connection(ctx, (network_connection_t *)events[i].data.ptr, events[i].events);
+      }
+    }
+
+    enforce_deadlines(ctx);
+  }
+
+  // Connections are closed by listener_stop once the workers have exited.
+  return NULL;
+}
@@ -36,8 +36,75 @@
 
 typedef void *network_ctx_t;
 
+/**
+ * @brief Checks a transaction a client reports as paying for a policy
+ *
+ * @param user_data user data given with network_set_transaction_cb
+ * @param policy_id ID of the policy the transaction pays for
+ * @param transaction_hash hash of the transaction
+ * @return int 1 if the transaction is confirmed, 0 if it is still pending, -1 on errors
+ */
+typedef int (*network_transaction_cb)(void *user_data, const char *policy_id, const char *transaction_hash);
+
+/**
+ * @brief Report every policy as paid to requests of the calling thread, or stop doing so
+ *
+ * @param enable 1 to evaluate requests as if their policy were paid, 0 to use the stored state again
+ */
+typedef void (*network_assume_paid_cb)(int enable);
+
+/**
+ * @brief Number of PEP actions and obligations run on the calling thread so far
+ *
+ * @return unsigned action count of the calling thread
+ */
+typedef unsigned (*network_action_count_cb)();
+
+/**
+ * @brief Turn PEP actions and obligations of the calling thread off and on again
+ *
+ * @param enable 1 to only evaluate requests from now on, 0 to run actions again
+ */
+typedef void (*network_dry_run_cb)(int enable);
+
 int network_init(network_ctx_t *network_context);
 int network_start(network_ctx_t network_context);
 void network_stop(network_ctx_t network_context);
+void network_invalidate_decisions(network_ctx_t network_context);
+
+/**
+ * @brief Set the handler of notify_transaction requests, must be called before network_start
+ *
+ * A notification is only checked if the policy would grant the request once paid. That is decided in
+ * a dry run, so notify_transaction also needs network_set_dry_run_cb.
+ *
+ * @param network_context network context
+ * @param cb transaction check, NULL to deny notify_transaction requests
+ * @param assume_paid_cb payment state override for the authorization, NULL to deny notify_transaction requests
+ * @param user_data passed to every cb call
+ */
+void network_set_transaction_cb(network_ctx_t network_context, network_transaction_cb cb,
+                                network_assume_paid_cb assume_paid_cb, void *user_data);
+
+/**
+ * @brief Set how to tell whether evaluating a request ran a PEP action, must be called before network_start
+ *
+ * Resolves that ran an action are never shared with other requests. Without a counter every resolve
+ * is taken to run one.
+ *
+ * @param network_context network context
+ * @param cb action counter of the calling thread
+ */
+void network_set_action_count_cb(network_ctx_t network_context, network_action_count_cb cb);
+
+/**
+ * @brief Set how to evaluate a request without enforcing it, must be called before network_start
+ *
+ * resolve_batch only reports decisions and runs no action, it is denied without this callback.
+ *
+ * @param network_context network context
+ * @param cb dry run switch of the calling thread
+ */
+void network_set_dry_run_cb(network_ctx_t network_context, network_dry_run_cb cb);
 
 #endif
@@ -0,0 +1,171 @@
+/*
+ * This file is part of the IOTA Access distribution
+ * (https://github.com/iotaledger/access)
+ *
+ * Copyright (c) 2020 IOTA Stiftung
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * \project IOTA Access
+ * \file rate_limiter.c
+ * \brief
+ * Implementation of the token bucket rate limiter
+ *
+ * \notes
+ *
+ * \history
+ * 16.10.2026. Initial version.
+ ****************************************************************************/
+
+#include "rate_limiter.h"
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#define RATELIMITER_PROBE_LEN 4
+#define RATELIMITER_TOKEN 1000
+
+typedef struct {
+  uint32_t key;
+  int used;
+  long long tokens;  // in thousandths of a token
+  long long last_ms;
+} ratelimiter_bucket_t;
+
+struct ratelimiter {
+  pthread_mutex_t lock;
+  ratelimiter_bucket_t *buckets;
+  int capacity;
+  int rate_per_s;
+  int burst;
+};
+
+ratelimiter_t *ratelimiter_create(int capacity, int rate_per_s, int burst) {
+  if (capacity < 1 || rate_per_s < 1 || burst < 1) {
+    return NULL;
+  }
+
+  ratelimiter_t *rl = calloc(1, sizeof(ratelimiter_t));
+  if (rl == NULL) {
+    return NULL;
+  }
+
+  rl->buckets = calloc(capacity, sizeof(ratelimiter_bucket_t));
+  if (rl->buckets == NULL) {
+    free(rl);
+    return NULL;
+  }
+
+  pthread_mutex_init(&rl->lock, NULL);
+  rl->capacity = capacity;
+  rl->rate_per_s = rate_per_s;
+  rl->burst = burst;
+
+  return rl;
+}
+
+// Milliseconds until a bucket is full again. Forgetting a full bucket loses nothing, as its key would
+// start over with a full bucket too.
+static long long refill_ms(ratelimiter_t *rl, ratelimiter_bucket_t *bucket, long long now_ms) {
+  long long missing = (long long)rl->burst * RATELIMITER_TOKEN - bucket->tokens;
+  long long ms = (missing + rl->rate_per_s - 1) / rl->rate_per_s - (now_ms - bucket->last_ms);
+
+  return ms > 0 ? ms : 0;
+}
+
+// Returns NULL when every probed bucket is still refilling. Evicting one would hand its key a full
+// bucket the next time, so the new key waits instead; *wait_ms is then when the first one is full.
+static ratelimiter_bucket_t *find_bucket(ratelimiter_t *rl, uint32_t key, long long now_ms, int *wait_ms) {
+  uint32_t hash = key * 2654435761u;
+  ratelimiter_bucket_t *victim = NULL;
+  long long min_refill_ms = LLONG_MAX;
+
+  for (int i = 0; i < RATELIMITER_PROBE_LEN; i++) {
+    ratelimiter_bucket_t *bucket = &rl->buckets[(hash + i) % rl->capacity];
+
+    if (bucket->used && bucket->key == key) {
+      return bucket;
+    }
+    if (!bucket->used) {
+      if (victim == NULL || victim->used) {
+        victim = bucket;
+      }
+      continue;
+    }
+
+    long long ms = refill_ms(rl, bucket, now_ms);
+    if (ms == 0 && (victim == NULL || (victim->used && bucket->last_ms < victim->last_ms))) {
+      victim = bucket;
+    }
+    if (ms < min_refill_ms) {
+      min_refill_ms = ms;
+    }
+  }
+
+  if (victim == NULL) {
+    *wait_ms = min_refill_ms > INT_MAX ? INT_MAX : (int)min_refill_ms;
+    return NULL;
+  }
+
+  // A new key starts with a full bucket.
+  victim->key = key;
+  victim->used = 1;
+  victim->tokens = (long long)rl->burst * RATELIMITER_TOKEN;
+  victim->last_ms = now_ms;
+
+  return victim;
+}
+
+int ratelimiter_allow(ratelimiter_t *rl, uint32_t key, long long now_ms) {
+  int wait_ms = 0;
+
+  pthread_mutex_lock(&rl->lock);
+
+  ratelimiter_bucket_t *bucket = find_bucket(rl, key, now_ms, &wait_ms);
+  if (bucket == NULL) {
+    pthread_mutex_unlock(&rl->lock);
+    return wait_ms;
+  }
+
+  long long max_tokens = (long long)rl->burst * RATELIMITER_TOKEN;
+
+  // rate_per_s tokens per second is rate_per_s thousandths of a token per millisecond.
+  bucket->tokens += (now_ms - bucket->last_ms) * rl->rate_per_s;
+  if (bucket->tokens > max_tokens) {
+    bucket->tokens = max_tokens;
+  }
+  bucket->last_ms = now_ms;
+
+  if (bucket->tokens >= RATELIMITER_TOKEN) {
+    bucket->tokens -= RATELIMITER_TOKEN;
+  } else {
+    wait_ms = (int)((RATELIMITER_TOKEN - bucket->tokens + rl->rate_per_s - 1) / rl->rate_per_s);
+  }
+
+  pthread_mutex_unlock(&rl->lock);
+
+  return wait_ms;
+}
+
+void ratelimiter_destroy(ratelimiter_t *rl) {
+  if (rl == NULL) {
+    return;
+  }
+
+  pthread_mutex_destroy(&rl->lock);
+  free(rl->buckets);
+  free(rl);
+}
@@ -0,0 +1,70 @@
+/*
+ * This file is part of the IOTA Access distribution
+ * (https://github.com/iotaledger/access)
+ *
+ * Copyright (c) 2020 IOTA Stiftung
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * \project IOTA Access
+ * \file rate_limiter.h
+ * \brief
+ * Token bucket rate limiter keyed by client address
+ *
+ * \notes
+ *
+ * \history
+ * 16.10.2026. Initial version.
+ ****************************************************************************/
+
+#ifndef _RATE_LIMITER_H_
+#define _RATE_LIMITER_H_
+
+#include <stdint.h>
+
+typedef struct ratelimiter ratelimiter_t;
+
+/**
+ * @brief Create a rate limiter
+ *
+ * Buckets live in a fixed table. A key is only forgotten once its bucket has refilled, so when
+ * the table is full of throttled keys, new keys are throttled too.
+ *
+ * @param capacity number of keys tracked at once
+ * @param rate_per_s tokens added to each bucket per second
+ * @param burst bucket size, at least 1
+ * @return ratelimiter_t* return NULL on errors
+ */
+ratelimiter_t *ratelimiter_create(int capacity, int rate_per_s, int burst);
+
+/**
+ * @brief Take one token from the bucket of a key
+ *
+ * @param rl the rate limiter
+ * @param key client key, e.g. an IPv4 address
+ * @param now_ms current monotonic time in milliseconds
+ * @return int 0 if a token was taken, otherwise milliseconds until the next token, or until a
+ * bucket is free for a new key
+ */
+int ratelimiter_allow(ratelimiter_t *rl, uint32_t key, long long now_ms);
+
+/**
+ * @brief Free the rate limiter
+ *
+ * @param rl the rate limiter
+ */
+void ratelimiter_destroy(ratelimiter_t *rl);
+
+#endif
@@ -0,0 +1,155 @@
+/*
+ * This file is part of the IOTA Access distribution
+ * (https://github.com/iotaledger/access)
+ *
+ * Copyright (c) 2020 IOTA Stiftung
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * \project IOTA Access
+ * \file single_flight.c
+ * \brief
+ * Implementation of the single flight group
+ *
+ * \notes
+ *
+ * \history
+ * 16.10.2026. Initial version.
+ ****************************************************************************/
+
+#include "single_flight.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  char key[SINGLEFLIGHT_KEY_LEN];
+  int key_len;
+  int in_use;
+  int done;
+  int result;
+  int waiters;
+} singleflight_call_t;
+
+struct singleflight {
+  pthread_mutex_t lock;
+  pthread_cond_t done;
+  singleflight_call_t *calls;
+  int capacity;
+};
+
+singleflight_t *singleflight_create(int capacity) {
+  if (capacity < 1) {
+    return NULL;
+  }
+
+  singleflight_t *sf = calloc(1, sizeof(singleflight_t));
+  if (sf == NULL) {
+    return NULL;
+  }
+
+  sf->calls = calloc(capacity, sizeof(singleflight_call_t));
+  if (sf->calls == NULL) {
+    free(sf);
+    return NULL;
+  }
+
+  pthread_mutex_init(&sf->lock, NULL);
+  pthread_cond_init(&sf->done, NULL);
+  sf->capacity = capacity;
+
+  return sf;
+}
+
+int singleflight_do(singleflight_t *sf, const char *key, int key_len, singleflight_fn fn, void *arg, int *shared) {
+  singleflight_call_t *call = NULL;
+  singleflight_call_t *free_call = NULL;
+
+  *shared = 0;
+
+  if (key_len >= SINGLEFLIGHT_KEY_LEN) {
+    return fn(arg);
+  }
+
+  pthread_mutex_lock(&sf->lock);
+
+  for (int i = 0; i < sf->capacity; i++) {
+    singleflight_call_t *c = &sf->calls[i];
+
+    // A finished call only lingers until its waiters have read the result, it is not joined anymore.
+    if (c->in_use && !c->done && c->key_len == key_len && memcmp(c->key, key, key_len) == 0) {
+      call = c;
+      break;
+    }
+    if (!c->in_use && free_call == NULL) {
+      free_call = c;
+    }
+  }
+
+  if (call != NULL) {
+    call->waiters++;
+    while (!call->done) {
+      pthread_cond_wait(&sf->done, &sf->lock);
+    }
+
+    int result = call->result;
+    *shared = 1;
+    if (--call->waiters == 0) {
+      call->in_use = 0;
+    }
+    pthread_mutex_unlock(&sf->lock);
+
+    return result;
+  }
+
+  if (free_call == NULL) {
+    pthread_mutex_unlock(&sf->lock);
+    return fn(arg);
+  }
+
+  call = free_call;
+  memcpy(call->key, key, key_len);
+  call->key_len = key_len;
+  call->in_use = 1;
+  call->done = 0;
+  call->waiters = 0;
+  pthread_mutex_unlock(&sf->lock);
+
+  int result = fn(arg);
+
+  pthread_mutex_lock(&sf->lock);
+  call->result = result;
+  call->done = 1;
+  if (call->waiters == 0) {
+    call->in_use = 0;
+  } else {
+    pthread_cond_broadcast(&sf->done);
+  }
+  pthread_mutex_unlock(&sf->lock);
+
+  return result;
+}
+
+void singleflight_destroy(singleflight_t *sf) {
+  if (sf == NULL) {
+    return;
+  }
+
+  pthread_cond_destroy(&sf->done);
+  pthread_mutex_destroy(&sf->lock);
+  free(sf->calls);
+  free(sf);
+}
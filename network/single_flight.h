@@ -0,0 +1,79 @@
+/*
+ * This file is part of the IOTA Access distribution
+ * (https://github.com/iotaledger/access)
+ *
+ * Copyright (c) 2020 IOTA Stiftung
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * \project IOTA Access
+ * \file single_flight.h
+ * \brief
+ * Coalescing of identical concurrent computations
+ *
+ * \notes
+ * Callers asking for a key that is already being computed wait for that
+ * computation and share its result instead of starting their own.
+ *
+ * \history
+ * 16.10.2026. Initial version.
+ ****************************************************************************/
+
+#ifndef _SINGLE_FLIGHT_H_
+#define _SINGLE_FLIGHT_H_
+
+#define SINGLEFLIGHT_KEY_LEN 256
+
+/**
+ * @brief Computation shared by all callers of the same key
+ *
+ * @param arg argument given by the caller that runs it
+ * @return int the result handed to every caller
+ */
+typedef int (*singleflight_fn)(void *arg);
+
+typedef struct singleflight singleflight_t;
+
+/**
+ * @brief Create a single flight group
+ *
+ * @param capacity maximum number of keys in flight at once
+ * @return singleflight_t* return NULL on errors
+ */
+singleflight_t *singleflight_create(int capacity);
+
+/**
+ * @brief Run fn, or wait for the run already in flight for the same key
+ *
+ * If the key is SINGLEFLIGHT_KEY_LEN or longer, or the group is full, fn is run without coalescing.
+ *
+ * @param sf the single flight group
+ * @param key key identifying the computation
+ * @param key_len key length
+ * @param fn computation to run
+ * @param arg argument for fn
+ * @param shared set to 1 if the result comes from a run of another caller, else to 0
+ * @return int result of fn
+ */
+int singleflight_do(singleflight_t *sf, const char *key, int key_len, singleflight_fn fn, void *arg, int *shared);
+
+/**
+ * @brief Free the single flight group, no call may be in flight
+ *
+ * @param sf the single flight group
+ */
+void singleflight_destroy(singleflight_t *sf);
+
+#endif
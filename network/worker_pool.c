@@ -0,0 +1,265 @@
+/*
+ * This file is part of the IOTA Access distribution
+ * (https://github.com/iotaledger/access)
+ *
+ * Copyright (c) 2020 IOTA Stiftung
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * \project IOTA Access
+ * \file worker_pool.c
+ * \brief
+ * Implementation of the fixed size thread pool
+ *
+ * \notes
+ *
+ * \history
+ * 16.10.2026. Initial version.
+ ****************************************************************************/
+
+#include "worker_pool.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+typedef struct {
+  workerpool_t *pool;
+  int idx;
+  pthread_t thread;
+} workerpool_worker_t;
+
+typedef struct {
+  void **queue;
+  int head;
+  int count;
+  int weight;
+  int credit;       // jobs the lane may still run in the current round
+  int max_running;  // 0 for no limit
+  int running;
+} workerpool_lane_t;
+
+struct workerpool {
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;
+
+  workerpool_lane_t lanes[WORKERPOOL_MAX_LANES];
+  int num_lanes;
+  int queue_len;
+  int count;
+  int end;
+
+  workerpool_job_cb job_cb;
+  void *user_data;
+
+  workerpool_worker_t *workers;
+  int num_workers;
+};
+
+static int lane_runnable(workerpool_lane_t *lane) {
+  return lane->count > 0 && (lane->max_running == 0 || lane->running < lane->max_running);
+}
+
+static int has_runnable_job(workerpool_t *pool) {
+  for (int i = 0; i < pool->num_lanes; i++) {
+    if (lane_runnable(&pool->lanes[i])) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+// Takes a job from the highest priority runnable lane that has credit left. A round ends when no
+// runnable lane has credit, then every lane gets its weight again.
+static void *next_job(workerpool_t *pool, int *lane_idx) {
+  for (int round = 0; round < 2; round++) {
+    for (int i = 0; i < pool->num_lanes; i++) {
+      workerpool_lane_t *lane = &pool->lanes[i];
+
+      if (lane_runnable(lane) && lane->credit > 0) {
+        void *job = lane->queue[lane->head];
+        lane->head = (lane->head + 1) % pool->queue_len;
+        lane->count--;
+        lane->credit--;
+        lane->running++;
+        pool->count--;
+        *lane_idx = i;
+        return job;
+      }
+    }
+
+    for (int i = 0; i < pool->num_lanes; i++) {
+      pool->lanes[i].credit = pool->lanes[i].weight;
+    }
+  }
+
+  return NULL;
+}
+
+static void *worker_thread_function(void *ptr) {
+  workerpool_worker_t *worker = (workerpool_worker_t *)ptr;
+  workerpool_t *pool = worker->pool;
+
+  while (1) {
+    int lane_idx = 0;
+
+    // Queued jobs of a lane at its limit wait for a job of that lane to finish, also when stopping.
+    pthread_mutex_lock(&pool->lock);
+    while (!has_runnable_job(pool) && !(pool->end && pool->count == 0)) {
+      pthread_cond_wait(&pool->not_empty, &pool->lock);
+    }
+
+    if (pool->count == 0) {
+      pthread_mutex_unlock(&pool->lock);
+      break;
+    }
+
+    void *job = next_job(pool, &lane_idx);
+    pthread_mutex_unlock(&pool->lock);
+
+    pool->job_cb(job, worker->idx, pool->user_data);
+
+    pthread_mutex_lock(&pool->lock);
+    workerpool_lane_t *lane = &pool->lanes[lane_idx];
+    lane->running--;
+    if (pool->end) {
+      pthread_cond_broadcast(&pool->not_empty);
+    } else if (lane->max_running > 0 && lane->count > 0) {
+      pthread_cond_signal(&pool->not_empty);
+    }
+    pthread_mutex_unlock(&pool->lock);
+  }
+
+  return NULL;
+}
+
+workerpool_t *workerpool_create(int num_workers, int queue_len, int num_lanes, const int *weights,
+                                workerpool_job_cb job_cb, void *user_data) {
+  if (num_workers < 1 || queue_len < 1 || num_lanes < 1 || num_lanes > WORKERPOOL_MAX_LANES || weights == NULL ||
+      job_cb == NULL) {
+    return NULL;
+  }
+
+  workerpool_t *pool = calloc(1, sizeof(workerpool_t));
+  if (pool == NULL) {
+    return NULL;
+  }
+
+  // Every lane can hold the whole queue, the limit applies to the sum of the lanes.
+  int lanes_ok = 1;
+  for (int i = 0; i < num_lanes; i++) {
+    pool->lanes[i].queue = calloc(queue_len, sizeof(void *));
+    pool->lanes[i].weight = weights[i] < 1 ? 1 : weights[i];
+    pool->lanes[i].credit = pool->lanes[i].weight;
+    lanes_ok = lanes_ok && pool->lanes[i].queue != NULL;
+  }
+  pool->num_lanes = num_lanes;
+
+  pool->workers = calloc(num_workers, sizeof(workerpool_worker_t));
+  if (!lanes_ok || pool->workers == NULL) {
+    for (int i = 0; i < num_lanes; i++) {
+      free(pool->lanes[i].queue);
+    }
+    free(pool->workers);
+    free(pool);
+    return NULL;
+  }
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->not_empty, NULL);
+  pool->queue_len = queue_len;
+  pool->job_cb = job_cb;
+  pool->user_data = user_data;
+
+  for (int i = 0; i < num_workers; i++) {
+    pool->workers[i].pool = pool;
+    pool->workers[i].idx = i;
+    if (pthread_create(&pool->workers[i].thread, NULL, worker_thread_function, &pool->workers[i])) {
+      break;
+    }
+    pool->num_workers++;
+  }
+
+  if (pool->num_workers == 0) {
+    workerpool_destroy(pool);
+    return NULL;
+  }
+
+  return pool;
+}
+
+int workerpool_set_lane_limit(workerpool_t *pool, int lane, int max_workers) {
+  if (lane < 0 || lane >= pool->num_lanes || max_workers < 0) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->lanes[lane].max_running = max_workers;
+  pthread_mutex_unlock(&pool->lock);
+
+  return 0;
+}
+
+int workerpool_submit(workerpool_t *pool, void *job, int lane) {
+  int ret = -1;
+
+  if (lane < 0 || lane >= pool->num_lanes) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  if (!pool->end && pool->count < pool->queue_len) {
+    workerpool_lane_t *l = &pool->lanes[lane];
+    l->queue[(l->head + l->count) % pool->queue_len] = job;
+    l->count++;
+    pool->count++;
+    pthread_cond_signal(&pool->not_empty);
+    ret = 0;
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  return ret;
+}
+
+int workerpool_pending(workerpool_t *pool) {
+  pthread_mutex_lock(&pool->lock);
+  int count = pool->count;
+  pthread_mutex_unlock(&pool->lock);
+
+  return count;
+}
+
+void workerpool_destroy(workerpool_t *pool) {
+  if (pool == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->end = 1;
+  pthread_cond_broadcast(&pool->not_empty);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (int i = 0; i < pool->num_workers; i++) {
+    pthread_join(pool->workers[i].thread, NULL);
+  }
+
+  pthread_cond_destroy(&pool->not_empty);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->workers);
+  for (int i = 0; i < pool->num_lanes; i++) {
+    free(pool->lanes[i].queue);
+  }
+  free(pool);
+}
@@ -0,0 +1,105 @@
+/*
+ * This file is part of the IOTA Access distribution
+ * (https://github.com/iotaledger/access)
+ *
+ * Copyright (c) 2020 IOTA Stiftung
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * \project IOTA Access
+ * \file worker_pool.h
+ * \brief
+ * Fixed size thread pool with a bounded work queue
+ *
+ * \notes
+ * Jobs are queued in priority lanes. Lane 0 has the highest priority; each lane
+ * may run up to its weight in jobs per round while lower lanes wait, so a busy
+ * lane cannot starve the others. A lane can also be limited to a number of
+ * workers, which keeps the rest free for the other lanes.
+ *
+ * \history
+ * 16.10.2026. Initial version.
+ ****************************************************************************/
+
+#ifndef _WORKER_POOL_H_
+#define _WORKER_POOL_H_
+
+#define WORKERPOOL_MAX_LANES 4
+
+/**
+ * @brief Job handler, called on a worker thread
+ *
+ * @param job the submitted job
+ * @param worker_idx index of the worker running the job, in [0, num_workers)
+ * @param user_data user data given at pool creation
+ */
+typedef void (*workerpool_job_cb)(void *job, int worker_idx, void *user_data);
+
+typedef struct workerpool workerpool_t;
+
+/**
+ * @brief Create a worker pool and start its threads
+ *
+ * @param num_workers number of worker threads
+ * @param queue_len maximum number of pending jobs, over all lanes
+ * @param num_lanes number of priority lanes, in [1, WORKERPOOL_MAX_LANES]
+ * @param weights jobs taken from each lane per round, values below 1 count as 1
+ * @param job_cb handler called for every job
+ * @param user_data passed to every job_cb call
+ * @return workerpool_t* return NULL on errors
+ */
+workerpool_t *workerpool_create(int num_workers, int queue_len, int num_lanes, const int *weights,
+                                workerpool_job_cb job_cb, void *user_data);
+
+/**
+ * @brief Limit how many workers may run jobs of a lane at once, must be called before submitting
+ *
+ * Jobs over the limit stay queued until a job of the lane finishes.
+ *
+ * @param pool the worker pool
+ * @param lane the lane
+ * @param max_workers maximum number of workers running jobs of the lane, 0 for no limit
+ * @return int 0 on success, -1 if the lane is not valid or max_workers is negative
+ */
+int workerpool_set_lane_limit(workerpool_t *pool, int lane, int max_workers);
+
+/**
+ * @brief Queue a job without blocking
+ *
+ * @param pool the worker pool
+ * @param job the job handed to job_cb
+ * @param lane priority lane of the job, 0 being the highest
+ * @return int 0 on success, -1 if the queue is full, the lane is not valid or the pool is stopping
+ */
+int workerpool_submit(workerpool_t *pool, void *job, int lane);
+
+/**
+ * @brief Number of jobs queued but not yet picked up by a worker
+ *
+ * @param pool the worker pool
+ * @return int pending job count
+ */
+int workerpool_pending(workerpool_t *pool);
+
+/**
+ * @brief Stop the workers and free the pool
+ *
+ * Jobs already queued are still run before the workers exit.
+ *
+ * @param pool the worker pool
+ */
+void workerpool_destroy(workerpool_t *pool);
+
+#endif
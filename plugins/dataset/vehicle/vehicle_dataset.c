@@ -37,7 +37,7 @@
 #include <string.h>
 
 #define JSMN_HEADER
-#include "jsmn.h"
+#include "json_parser.h"
 
 #define TOK_NUM_MAX 256
 #define TOKNAME_LEN 128
@@ -151,21 +151,20 @@ void vehicledataset_deinit(vehicledataset_state_t *state) {
 
 void vehicledataset_from_json(vehicledataset_state_t *state, const char *json, size_t json_len) {
   int num_of_tokens = -1;
-  jsmn_parser parser;
+  jsonparser_ctx_t parser;
   jsmntok_t tokens[TOK_NUM_MAX];
   int arr_len = 0;
   int arr_index = -1;
 
-  jsmn_init(&parser);
-  num_of_tokens = jsmn_parse(&parser, json, json_len, NULL, 0);
+  // A single pass into bounded storage, instead of counting tokens first and then trusting the
+  // count to fit in TOK_NUM_MAX.
+  jsonparser_init(&parser, tokens, TOK_NUM_MAX);
+  num_of_tokens = jsonparser_parse(&parser, json, json_len);
 
-  if ((num_of_tokens == -1) || (num_of_tokens < 1)) {
+  if (num_of_tokens < 1) {
     return;
   }
 
-  jsmn_init(&parser);
-  num_of_tokens = jsmn_parse(&parser, json, json_len, (jsmntok_t *)&tokens, num_of_tokens);
-
   for (int i = 0; i < num_of_tokens; i++) {
     if (tokens[i].type == JSMN_ARRAY) {
       arr_index = i;
@@ -0,0 +1,246 @@
+/*
+ * This file is part of the IOTA Access distribution
+ * (https://github.com/iotaledger/access)
+ *
+ * Copyright (c) 2020 IOTA Stiftung
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * \project IOTA Access
+ * \file pep_action_executor.c
+ * \brief
+ * Implementation of the background PEP action executor.
+ *
+ * \notes
+ *
+ * \history
+ * 16.10.2026. Initial version.
+ ****************************************************************************/
+
+#include "pep_action_executor.h"
+#include "plugin_logger.h"
+
+#include <pthread.h>
+#include <string.h>
+
+// Number of finished jobs whose state can still be queried.
+#define PEPEXECUTOR_HISTORY_LEN 64
+
+// The job owns copies of the strings the action points to, as the PEP reuses its buffers once the
+// action callback has returned.
+typedef struct {
+  unsigned id;
+  pdp_action_t action;
+  char transaction_hash[PEPEXECUTOR_TX_HASH_LEN + 1];
+  char obligation[PEPEXECUTOR_OBLIGATION_LEN];
+} pepexecutor_job_t;
+
+typedef struct {
+  unsigned id;
+  pepexecutor_job_state_e state;
+} pepexecutor_result_t;
+
+struct pepexecutor {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;
+
+  pepexecutor_job_t* queue;
+  int queue_len;
+  int head;
+  int count;
+  int end;
+
+  unsigned next_id;
+  // Indexed by job ID. With room for a full queue on top of the history, a slot is only reused
+  // once its job has finished and PEPEXECUTOR_HISTORY_LEN later jobs were submitted.
+  pepexecutor_result_t* history;
+  int history_len;
+
+  pepexecutor_job_cb job_cb;
+};
+
+static void set_state(pepexecutor_t* executor, unsigned id, pepexecutor_job_state_e state) {
+  pepexecutor_result_t* result = &executor->history[id % executor->history_len];
+
+  result->id = id;
+  result->state = state;
+}
+
+static void* executor_thread_function(void* ptr) {
+  pepexecutor_t* executor = (pepexecutor_t*)ptr;
+  pepexecutor_job_t job;
+
+  while (1) {
+    pthread_mutex_lock(&executor->lock);
+    while (executor->count == 0 && !executor->end) {
+      pthread_cond_wait(&executor->not_empty, &executor->lock);
+    }
+
+    if (executor->count == 0) {
+      pthread_mutex_unlock(&executor->lock);
+      break;
+    }
+
+    memcpy(&job, &executor->queue[executor->head], sizeof(pepexecutor_job_t));
+    executor->head = (executor->head + 1) % executor->queue_len;
+    executor->count--;
+    set_state(executor, job.id, PEPEXECUTOR_JOB_RUNNING);
+    pthread_mutex_unlock(&executor->lock);
+
+    // The copied action still points into the queue slot, which may be reused from now on.
+    if (job.action.transaction_hash != NULL) {
+      job.action.transaction_hash = job.transaction_hash;
+    }
+
+    int status = executor->job_cb(&job.action, job.obligation);
+    if (status == 0) {
+      log_info(plugin_logger_id, "[%s:%d] Action %s (job %u) done.\n", __func__, __LINE__, job.action.value, job.id);
+    } else {
+      log_error(plugin_logger_id, "[%s:%d] Action %s (job %u) failed.\n", __func__, __LINE__, job.action.value, job.id);
+    }
+
+    pthread_mutex_lock(&executor->lock);
+    set_state(executor, job.id, status == 0 ? PEPEXECUTOR_JOB_DONE : PEPEXECUTOR_JOB_FAILED);
+    pthread_mutex_unlock(&executor->lock);
+  }
+
+  return NULL;
+}
+
+pepexecutor_t* pepexecutor_create(int queue_len, pepexecutor_job_cb job_cb) {
+  if (queue_len < 1 || job_cb == NULL) {
+    return NULL;
+  }
+
+  pepexecutor_t* executor = calloc(1, sizeof(pepexecutor_t));
+  if (executor == NULL) {
+    return NULL;
+  }
+
+  executor->history_len = queue_len + PEPEXECUTOR_HISTORY_LEN;
+  executor->queue = calloc(queue_len, sizeof(pepexecutor_job_t));
+  executor->history = calloc(executor->history_len, sizeof(pepexecutor_result_t));
+  if (executor->queue == NULL || executor->history == NULL) {
+    free(executor->history);
+    free(executor->queue);
+    free(executor);
+    return NULL;
+  }
+
+  pthread_mutex_init(&executor->lock, NULL);
+  pthread_cond_init(&executor->not_empty, NULL);
+  executor->queue_len = queue_len;
+  executor->next_id = 1;
+  executor->job_cb = job_cb;
+
+  if (pthread_create(&executor->thread, NULL, executor_thread_function, executor)) {
+    pthread_cond_destroy(&executor->not_empty);
+    pthread_mutex_destroy(&executor->lock);
+    free(executor->history);
+    free(executor->queue);
+    free(executor);
+    return NULL;
+  }
+
+  return executor;
+}
+
+unsigned pepexecutor_submit(pepexecutor_t* executor, pdp_action_t* action, char* obligation) {
+  unsigned id = 0;
+
+  pthread_mutex_lock(&executor->lock);
+  if (!executor->end && executor->count < executor->queue_len) {
+    pepexecutor_job_t* job = &executor->queue[(executor->head + executor->count) % executor->queue_len];
+
+    id = executor->next_id++;
+    if (executor->next_id == 0) {
+      executor->next_id = 1;
+    }
+
+    job->id = id;
+    memcpy(&job->action, action, sizeof(pdp_action_t));
+    if (action->transaction_hash != NULL) {
+      int len = action->transaction_hash_len;
+      if (len < 0 || len > PEPEXECUTOR_TX_HASH_LEN) {
+        len = PEPEXECUTOR_TX_HASH_LEN;
+      }
+      memcpy(job->transaction_hash, action->transaction_hash, len);
+      job->transaction_hash[len] = '\0';
+      job->action.transaction_hash = job->transaction_hash;
+      job->action.transaction_hash_len = len;
+    }
+    job->obligation[0] = '\0';
+    if (obligation != NULL) {
+      strncpy(job->obligation, obligation, PEPEXECUTOR_OBLIGATION_LEN - 1);
+      job->obligation[PEPEXECUTOR_OBLIGATION_LEN - 1] = '\0';
+    }
+
+    set_state(executor, id, PEPEXECUTOR_JOB_PENDING);
+    executor->count++;
+    pthread_cond_signal(&executor->not_empty);
+  }
+  pthread_mutex_unlock(&executor->lock);
+
+  return id;
+}
+
+pepexecutor_job_state_e pepexecutor_job_state(pepexecutor_t* executor, unsigned id) {
+  pepexecutor_job_state_e state = PEPEXECUTOR_JOB_UNKNOWN;
+
+  pthread_mutex_lock(&executor->lock);
+  pepexecutor_result_t* result = &executor->history[id % executor->history_len];
+  if (id != 0 && result->id == id) {
+    state = result->state;
+  }
+  pthread_mutex_unlock(&executor->lock);
+
+  return state;
+}
+
+int pepexecutor_run(pepexecutor_t* executor, pepexecutor_job_cb job_cb, pdp_action_t* action, char* obligation) {
+  if (executor == NULL) {
+    return job_cb(action, obligation);
+  }
+
+  // The decision goes back to the client as soon as this returns, the action runs afterwards.
+  unsigned id = pepexecutor_submit(executor, action, obligation);
+  if (id == 0) {
+    log_error(plugin_logger_id, "[%s:%d] Action queue full, %s not performed.\n", __func__, __LINE__, action->value);
+    return -1;
+  }
+
+  log_info(plugin_logger_id, "[%s:%d] Action %s queued as job %u.\n", __func__, __LINE__, action->value, id);
+  return 0;
+}
+
+void pepexecutor_destroy(pepexecutor_t* executor) {
+  if (executor == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&executor->lock);
+  executor->end = 1;
+  pthread_cond_broadcast(&executor->not_empty);
+  pthread_mutex_unlock(&executor->lock);
+
+  pthread_join(executor->thread, NULL);
+
+  pthread_cond_destroy(&executor->not_empty);
+  pthread_mutex_destroy(&executor->lock);
+  free(executor->history);
+  free(executor->queue);
+  free(executor);
+}
@@ -0,0 +1,114 @@
+/*
+ * This file is part of the IOTA Access distribution
+ * (https://github.com/iotaledger/access)
+ *
+ * Copyright (c) 2020 IOTA Stiftung
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * \project IOTA Access
+ * \file pep_action_executor.h
+ * \brief
+ * Runs PEP actions and obligations in the background, after the decision
+ * has been sent to the client.
+ *
+ * \notes
+ * Jobs run one at a time and in submission order, so e.g. a relay is never
+ * switched off before an earlier request switched it on.
+ *
+ * \history
+ * 16.10.2026. Initial version.
+ ****************************************************************************/
+
+#ifndef _PEP_ACTION_EXECUTOR_H_
+#define _PEP_ACTION_EXECUTOR_H_
+
+#include "pep_plugin.h"
+
+#define PEPEXECUTOR_OBLIGATION_LEN 64
+#define PEPEXECUTOR_TX_HASH_LEN 81
+
+typedef enum {
+  PEPEXECUTOR_JOB_UNKNOWN,
+  PEPEXECUTOR_JOB_PENDING,
+  PEPEXECUTOR_JOB_RUNNING,
+  PEPEXECUTOR_JOB_DONE,
+  PEPEXECUTOR_JOB_FAILED
+} pepexecutor_job_state_e;
+
+/**
+ * @brief Action handler, called on the executor thread
+ *
+ * @param action copy of the action given to the plugin
+ * @param obligation copy of the obligation given to the plugin
+ * @return int 0 on success
+ */
+typedef int (*pepexecutor_job_cb)(pdp_action_t* action, char* obligation);
+
+typedef struct pepexecutor pepexecutor_t;
+
+/**
+ * @brief Create an executor and start its thread
+ *
+ * @param queue_len maximum number of actions waiting to run
+ * @param job_cb handler run for every submitted action
+ * @return pepexecutor_t* return NULL on errors
+ */
+pepexecutor_t* pepexecutor_create(int queue_len, pepexecutor_job_cb job_cb);
+
+/**
+ * @brief Queue an action without blocking
+ *
+ * The action is copied together with the strings it points to. The outcome of the job is logged
+ * under its ID once it has run.
+ *
+ * @param executor the executor
+ * @param action action to copy into the job
+ * @param obligation obligation to copy into the job, may be NULL
+ * @return unsigned job ID for pepexecutor_job_state, 0 if the queue is full
+ */
+unsigned pepexecutor_submit(pepexecutor_t* executor, pdp_action_t* action, char* obligation);
+
+/**
+ * @brief State of a submitted job
+ *
+ * Queued jobs and the most recent finished ones are remembered, older ones report
+ * PEPEXECUTOR_JOB_UNKNOWN.
+ *
+ * @param executor the executor
+ * @param id job ID returned by pepexecutor_submit
+ * @return pepexecutor_job_state_e job state
+ */
+pepexecutor_job_state_e pepexecutor_job_state(pepexecutor_t* executor, unsigned id);
+
+/**
+ * @brief Run an action from a PEP plugin action callback
+ *
+ * @param executor the executor, NULL to run the action synchronously
+ * @param job_cb handler for the synchronous case, the one the executor was created with
+ * @param action the action
+ * @param obligation the obligation, may be NULL
+ * @return int result of job_cb when run synchronously, else 0 if queued and -1 if the queue is full
+ */
+int pepexecutor_run(pepexecutor_t* executor, pepexecutor_job_cb job_cb, pdp_action_t* action, char* obligation);
+
+/**
+ * @brief Run the queued actions, stop the thread and free the executor
+ *
+ * @param executor the executor
+ */
+void pepexecutor_destroy(pepexecutor_t* executor);
+
+#endif  //_PEP_ACTION_EXECUTOR_H_
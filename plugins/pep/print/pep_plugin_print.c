@@ -39,12 +39,14 @@
 #include "stdlib.h"
 
 #include "config_manager.h"
+#include "pep_action_executor.h"
 #include "wallet.h"
 
 #define RES_BUFF_LEN 80
 #define MAX_ACTIONS 10
 #define ACTION_NAME_SIZE 16
 #define POLICY_ID_SIZE 64
+#define ACTION_QUEUE_LEN 16
 #define ADDR_SIZE 128
 
 typedef int (*action_t)(pdp_action_t* action);
@@ -57,6 +59,7 @@ typedef struct {
 
 static wallet_ctx_t* dev_wallet = NULL;
 static action_set_t g_action_set;
+static pepexecutor_t* g_executor = NULL;
 
 static int log_tangle(pdp_action_t* action) {
   char bundle_hash[NUM_TRYTES_BUNDLE + 1] = {};
@@ -82,12 +85,14 @@ static int print_terminal(pdp_action_t* action) {
   return 0;
 }
 
-static int destroy_cb(plugin_t* plugin, void* data) { free(plugin->callbacks); }
+static int destroy_cb(plugin_t* plugin, void* data) {
+  pepexecutor_destroy(g_executor);
+  g_executor = NULL;
+  free(plugin->callbacks);
+  return 0;
+}
 
-static int action_cb(plugin_t* plugin, void* data) {
-  pep_plugin_args_t* args = (pep_plugin_args_t*)data;
-  pdp_action_t* action = &args->action;
-  char* obligation = args->obligation;
+static int run_action(pdp_action_t* action, char* obligation) {
   int status = 0;
 
   // handle obligations
@@ -106,6 +111,12 @@ static int action_cb(plugin_t* plugin, void* data) {
   return status;
 }
 
+static int action_cb(plugin_t* plugin, void* data) {
+  pep_plugin_args_t* args = (pep_plugin_args_t*)data;
+
+  return pepexecutor_run(g_executor, run_action, &args->action, args->obligation);
+}
+
 int pep_plugin_print_initializer(plugin_t* plugin, void* wallet_context) {
   dev_wallet = wallet_context;
   if (dev_wallet == NULL) {
@@ -117,6 +128,18 @@ int pep_plugin_print_initializer(plugin_t* plugin, void* wallet_context) {
   strncpy(g_action_set.action_names[0], "action#1", ACTION_NAME_SIZE);
   g_action_set.count = 1;
 
+  int async_actions = 0;
+  int queue_len = ACTION_QUEUE_LEN;
+  config_manager_get_option_int("pep", "async_actions", &async_actions);
+  config_manager_get_option_int("pep", "action_queue_len", &queue_len);
+  if (async_actions) {
+    g_executor = pepexecutor_create(queue_len, run_action);
+    if (g_executor == NULL) {
+      log_error(plugin_logger_id, "[%s:%d] Action executor not started, actions run synchronously.\n", __func__,
+                __LINE__);
+    }
+  }
+
   plugin->destroy = destroy_cb;
   plugin->callbacks = malloc(sizeof(void*) * PEP_PLUGIN_CALLBACK_COUNT);
   plugin->callbacks_num = PEP_PLUGIN_CALLBACK_COUNT;
@@ -24,6 +24,7 @@
 #include <unistd.h>
 
 #include "config_manager.h"
+#include "pep_action_executor.h"
 #include "relay_interface.h"
 #include "wallet.h"
 
@@ -31,6 +32,7 @@
 #define MAX_ACTIONS 10
 #define ACTION_NAME_SIZE 16
 #define POLICY_ID_SIZE 64
+#define ACTION_QUEUE_LEN 16
 #define ADDR_SIZE 128
 #define ACTION_ADDRESS "MXHYKULAXKWBY9JCNVPVSOSZHMBDJRWTTXZCTKHLHKSJARDADHJSTCKVQODBVWCYDNGWFGWVTUVENB9UA"
 #define ACTION_MSG_MAX_SIZE 512
@@ -45,6 +47,7 @@ typedef struct {
 
 static wallet_ctx_t* dev_wallet = NULL;
 static action_set_t g_action_set;
+static pepexecutor_t* g_executor = NULL;
 
 static int log_tangle(char* msg) {
   char bundle_hash[NUM_TRYTES_BUNDLE + 1] = {};
@@ -93,12 +96,14 @@ static int relay_off() {
   return 0;
 }
 
-static int destroy_cb(plugin_t* plugin, void* data) { free(plugin->callbacks); }
+static int destroy_cb(plugin_t* plugin, void* data) {
+  pepexecutor_destroy(g_executor);
+  g_executor = NULL;
+  free(plugin->callbacks);
+  return 0;
+}
 
-static int action_cb(plugin_t* plugin, void* data) {
-  pep_plugin_args_t* args = (pep_plugin_args_t*)data;
-  pdp_action_t* action = &args->action;
-  char* obligation = args->obligation;
+static int run_action(pdp_action_t* action, char* obligation) {
   char buf[RES_BUFF_LEN];
   int status = 0;
 
@@ -119,6 +124,12 @@ static int action_cb(plugin_t* plugin, void* data) {
   return status;
 }
 
+static int action_cb(plugin_t* plugin, void* data) {
+  pep_plugin_args_t* args = (pep_plugin_args_t*)data;
+
+  return pepexecutor_run(g_executor, run_action, &args->action, args->obligation);
+}
+
 int pep_plugin_relay_initializer(plugin_t* plugin, void* wallet_context) {
   dev_wallet = wallet_context;
   if (dev_wallet == NULL) {
@@ -132,6 +143,18 @@ int pep_plugin_relay_initializer(plugin_t* plugin, void* wallet_context) {
   strncpy(g_action_set.action_names[1], "action#2", ACTION_NAME_SIZE);
   g_action_set.count = 2;
 
+  int async_actions = 0;
+  int queue_len = ACTION_QUEUE_LEN;
+  config_manager_get_option_int("pep", "async_actions", &async_actions);
+  config_manager_get_option_int("pep", "action_queue_len", &queue_len);
+  if (async_actions) {
+    g_executor = pepexecutor_create(queue_len, run_action);
+    if (g_executor == NULL) {
+      log_error(plugin_logger_id, "[%s:%d] Action executor not started, actions run synchronously.\n", __func__,
+                __LINE__);
+    }
+  }
+
   plugin->destroy = destroy_cb;
   plugin->callbacks = malloc(sizeof(void*) * PEP_PLUGIN_CALLBACK_COUNT);
   plugin->callbacks_num = PEP_PLUGIN_CALLBACK_COUNT;
@@ -1,6 +1,7 @@
 #include "pip_plugin_wallet.h"
 
 #include "config_manager.h"
+#include "pap.h"
 #include "pthread.h"
 
 #define PROTOCOL_TRANSACTION_NOT_PAID 0
@@ -33,6 +34,8 @@ typedef struct serv_confirm {
 #define TRANS_MAX_STR_LEN 512
 #define TRANS_SEED_LEN 81 + 1
 #define TRANS_MAX_PEM_LEN 4 * 1024
+#define TRANS_HASH_LEN 81
+#define TRANS_USED_FILE_DEFAULT "used_transactions"
 
 /****************************************************************************
  * GLOBAL VARIBLES
@@ -40,6 +43,8 @@ typedef struct serv_confirm {
 static transaction_serv_confirm_t service[TRANS_CONF_SERV_MAX_NUM] = {0};
 static pthread_mutex_t trans_mutex;
 static wallet_ctx_t *dev_wallet;
+static char used_tx_file[TRANS_MAX_STR_LEN];
+static __thread int assume_paid = 0;
 
 /****************************************************************************
  * LOCAL FUNCTIONS
@@ -96,9 +101,137 @@ static int recover_transaction(char *policy_id, int policy_id_len) {
   }
 #else
   // Add support for other platforms
+  pthread_mutex_unlock(&trans_mutex);
+  return TRANS_NOT_PAYED;
 #endif
 }
 
+// The price of a policy is the cost of its policy object, in iotas.
+static int policy_price(char *policy_id, int policy_id_len, uint64_t *price) {
+  pap_policy_t policy;
+  int policy_object_len = 0;
+  char *end = NULL;
+
+  if (pap_get_policy_obj_len(policy_id, policy_id_len, &policy_object_len) != PAP_NO_ERROR) {
+    return -1;
+  }
+
+  memset(&policy, 0, sizeof(policy));
+  policy.policy_object.policy_object = malloc(policy_object_len * sizeof(char));
+  if (policy.policy_object.policy_object == NULL) {
+    return -1;
+  }
+
+  int ret = pap_get_policy(policy_id, policy_id_len, &policy);
+  free(policy.policy_object.policy_object);
+  if (ret != PAP_NO_ERROR) {
+    return -1;
+  }
+
+  *price = strtoull(policy.policy_object.cost, &end, 10);
+
+  return end == policy.policy_object.cost ? -1 : 0;
+}
+
+// A transaction pays for one policy once. Each accepted hash is kept as a "<hash>:<policy ID>" line,
+// so the same payment can be reported neither again nor for another policy, also after a restart.
+static bool transaction_is_used(char *transaction_hash) {
+  char line[TRANS_MAX_STR_LEN];
+  bool used = false;
+
+  FILE *f = fopen(used_tx_file, "r");
+  if (f == NULL) {
+    // No transaction was accepted yet
+    return false;
+  }
+
+  while (!used && fgets(line, TRANS_MAX_STR_LEN, f) != NULL) {
+    used = memcmp(line, transaction_hash, TRANS_HASH_LEN) == 0 && line[TRANS_HASH_LEN] == ':';
+  }
+  fclose(f);
+
+  return used;
+}
+
+static bool transaction_mark_used(char *transaction_hash, char *policy_id, int policy_id_len) {
+  FILE *f = fopen(used_tx_file, "a");
+  if (f == NULL) {
+    printf("\nERROR[%s]: Invalid path to file.\n", __FUNCTION__);
+    return false;
+  }
+
+  fprintf(f, "%.*s:%.*s\n", TRANS_HASH_LEN, transaction_hash, policy_id_len, policy_id);
+  return fclose(f) == 0;
+}
+
+int pip_plugin_wallet_notify_transaction(char *policy_id, int policy_id_len, char *transaction_hash) {
+  char message[TRANS_MAX_STR_LEN];
+
+  // Check input parameters
+  if (policy_id == NULL || transaction_hash == NULL || dev_wallet == NULL || strlen(transaction_hash) != TRANS_HASH_LEN) {
+    printf("\nERROR[%s]: Bad input prameter.\n", __FUNCTION__);
+    return -1;
+  }
+
+  pthread_mutex_lock(&trans_mutex);
+  bool used = transaction_is_used(transaction_hash);
+  pthread_mutex_unlock(&trans_mutex);
+  if (used) {
+    printf("\nERROR[%s]: Transaction already paid for a policy.\n", __FUNCTION__);
+    return -1;
+  }
+
+  uint64_t price = 0;
+  if (policy_price(policy_id, policy_id_len, &price) != 0) {
+    printf("\nERROR[%s]: Policy price not available.\n", __FUNCTION__);
+    return -1;
+  }
+
+  // Any confirmed transaction could be reported, only one that moves the price to this device and
+  // names the policy in its message pays for it.
+  uint64_t value = 0;
+  if (wallet_check_payment(dev_wallet, transaction_hash, &value, message, TRANS_MAX_STR_LEN) != WALLET_OK ||
+      value < price || strlen(message) != policy_id_len || memcmp(message, policy_id, policy_id_len) != 0) {
+    printf("\nERROR[%s]: Transaction does not pay for the policy.\n", __FUNCTION__);
+    return -1;
+  }
+
+#ifdef USE_RPI
+  bool is_confirmed = wallet_check_confirmation(dev_wallet, transaction_hash);
+
+  pthread_mutex_lock(&trans_mutex);
+
+  // Checked again, as the same hash may have been reported twice at once.
+  if (transaction_is_used(transaction_hash) || !transaction_mark_used(transaction_hash, policy_id, policy_id_len)) {
+    printf("\nERROR[%s]: Transaction already paid for a policy.\n", __FUNCTION__);
+    pthread_mutex_unlock(&trans_mutex);
+    return -1;
+  }
+
+  if (!rpitransaction_is_stored(policy_id) && !rpitransaction_store(policy_id, policy_id_len)) {
+    printf("\nERROR[%s]: Failed to store transaction.\n", __FUNCTION__);
+    pthread_mutex_unlock(&trans_mutex);
+    return -1;
+  }
+
+  if (is_confirmed && !rpitransaction_update_payment_status(policy_id, policy_id_len, is_confirmed)) {
+    printf("\nERROR[%s]: Failed to store transaction.\n", __FUNCTION__);
+    pthread_mutex_unlock(&trans_mutex);
+    return -1;
+  }
+
+  pthread_mutex_unlock(&trans_mutex);
+
+  return is_confirmed ? 1 : 0;
+#else
+  // Add support for other platforms
+  printf("\nERROR[%s]: No storage for the payment state on this platform.\n", __FUNCTION__);
+  return -1;
+#endif
+}
+
+void pip_plugin_wallet_assume_paid(int enable) { assume_paid = enable; }
+
 static int destroy_cb(plugin_t *plugin, void *not_used) {
   free(plugin->callbacks);
   return 0;
@@ -144,7 +277,9 @@ static int acquire_cb(plugin_t *plugin, void *user_data) {
 
   if (memcmp(type, "request.isPayed.type", strlen("request.isPayed.type")) == 0) {
     memcpy(args->attribute.type, "string", strlen("string"));
-    if (recover_transaction != NULL) {
+    if (assume_paid) {
+      memcpy(args->attribute.value, "verified", strlen("verified"));
+    } else if (recover_transaction != NULL) {
       int ret = recover_transaction(pol_id, strlen(pol_id));
 
       if (ret == PROTOCOL_TRANSACTION_PAID_VERIFIED) {
@@ -167,7 +302,7 @@ static int acquire_cb(plugin_t *plugin, void *user_data) {
   return 0;
 }
 
-int pip_plugin_wallet_initializer(plugin_t *plugin, void *user_data) {
+static wallet_ctx_t *wallet_from_config() {
   char node_url[TRANS_MAX_STR_LEN] = {0};
   char seed[TRANS_SEED_LEN] = {0};
   uint8_t node_mwm;
@@ -185,23 +320,34 @@ int pip_plugin_wallet_initializer(plugin_t *plugin, void *user_data) {
 
   if (strlen(pem_file) == 0) {
     printf("\nERROR[%s]: PEM file for wallet not defined in config.\n", __FUNCTION__);
-    return -1;
+    return NULL;
   }
 
   FILE *f = fopen(pem_file, "r");
   if (f == NULL) {
     printf("\nERROR[%s]: PEM file (%s) not found.\n", __FUNCTION__, pem_file);
-    return -1;
+    return NULL;
   }
   fread(ca_pem, TRANS_MAX_PEM_LEN, 1, f);
   fclose(f);
 
-  dev_wallet = wallet_create(node_url, port, ca_pem, node_depth, node_mwm, seed);
+  return wallet_create(node_url, port, ca_pem, node_depth, node_mwm, seed);
+}
+
+int pip_plugin_wallet_initializer(plugin_t *plugin, void *user_data) {
+  // Reuse the wallet of the caller when there is one, instead of opening a second node connection.
+  dev_wallet = user_data != NULL ? (wallet_ctx_t *)user_data : wallet_from_config();
   if (dev_wallet == NULL) {
     printf("\nERROR[%s]: Wallet creation failed.\n", __FUNCTION__);
     return -1;
   }
 
+  if (config_manager_get_option_string("wallet", "used_transactions_file", used_tx_file, TRANS_MAX_STR_LEN) !=
+          CONFIG_MANAGER_OK ||
+      strlen(used_tx_file) == 0) {
+    strcpy(used_tx_file, TRANS_USED_FILE_DEFAULT);
+  }
+
   plugin->destroy = destroy_cb;
   plugin->callbacks = malloc(sizeof(void *) * PIP_PLUGIN_CALLBACK_COUNT);
   plugin->callbacks[PIP_PLUGIN_ACQUIRE_CB] = acquire_cb;
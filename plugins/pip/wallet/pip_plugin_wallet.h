@@ -6,4 +6,28 @@
 
 int pip_plugin_wallet_initializer(plugin_t *plugin, void *user_data);
 
+/**
+ * @brief Check a transaction paying for a policy now and store its payment state
+ *
+ * The transaction must move at least the price of the policy to an address of the device wallet,
+ * carry the policy ID as its message, and must not have paid before. Accepted hashes are stored
+ * together with their policy ID in the [wallet] used_transactions_file.
+ *
+ * @param policy_id ID of the policy the transaction pays for
+ * @param policy_id_len length of policy_id
+ * @param transaction_hash hash of the transaction
+ * @return int 1 if the transaction is confirmed, 0 if it is still pending, -1 if it does not pay for
+ * the policy or on errors
+ */
+int pip_plugin_wallet_notify_transaction(char *policy_id, int policy_id_len, char *transaction_hash);
+
+/**
+ * @brief Report every policy as paid to requests of the calling thread, or stop doing so
+ *
+ * Lets a payment be authorized by the policy it pays for, which would otherwise deny until paid.
+ *
+ * @param enable 1 to report isPayed as verified, 0 to report the stored state again
+ */
+void pip_plugin_wallet_assume_paid(int enable);
+
 #endif
@@ -23,10 +23,11 @@
 #include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "config_manager.h"
-#include "json_helper.h"
+#include "json_parser.h"
 #include "pap.h"
 #include "time_manager.h"
 #include "utils.h"
@@ -62,6 +63,11 @@
 #define POLICY_LOADER_PUBLIC_KEY_LEN 32
 #define POLICY_LOADER_PUBLIC_KEY_B64_LEN 44
 #define POLICY_LOADER_SIGNATURE_LEN 64
+#define POLICY_LOADER_DEFAULT_BATCH_LEN 16
+#define POLICY_LOADER_DEFAULT_POLL_MIN_MS 5000
+#define POLICY_LOADER_DEFAULT_POLL_MAX_MS 60000
+#define POLICY_LOADER_DEFAULT_SUBSCRIBE_TIMEOUT_MS 30000
+#define POLICY_LOADER_WAIT_SLICE_MS 100
 
 #define POLICY_LOADER_POL_RESPONSE_TYPE_ARRAY 2
 #define POLICY_LOADER_POL_RESPONSE_TYPE_STRING 3
@@ -93,17 +99,40 @@ static char g_action_ps[] = "<policy service connection>";
 
 static int g_task_sleep_time = -1;
 
+static int g_policy_batch_len = POLICY_LOADER_DEFAULT_BATCH_LEN;
+
+// With a subscription the store tells when to sync. Without one the loader polls, starting every
+// g_poll_min_ms and doubling the interval up to g_poll_max_ms while nothing changes.
+static int g_subscribe = 1;
+static int g_subscribe_timeout_ms = POLICY_LOADER_DEFAULT_SUBSCRIBE_TIMEOUT_MS;
+static int g_poll_min_ms = POLICY_LOADER_DEFAULT_POLL_MIN_MS;
+static int g_poll_max_ms = POLICY_LOADER_DEFAULT_POLL_MAX_MS;
+
 static int g_end;
 
 static pthread_t g_thread;
 
-static jsmn_parser p;
-static jsmntok_t t[POLICY_LOADER_TOK_NUM];
-static int r = 0;
+static pthread_mutex_t g_update_cb_lock = PTHREAD_MUTEX_INITIALIZER;
+static policyloader_update_cb g_update_cb = NULL;
+static void *g_update_cb_data = NULL;
+
+// Tokens of the policy list, read by receive_policies after parse_policy_service_list. Both run
+// on the loader thread only.
+static jsmntok_t g_policy_list_tokens[POLICY_LOADER_TOK_NUM];
+static jsonparser_ctx_t g_policy_list_parser;
 
 static int cycle_fsm();
 static unsigned int receive_policies(void);
 
+// Tells the registered listener, e.g. the network decision cache, that the PAP content changed.
+static void notify_update(void) {
+  pthread_mutex_lock(&g_update_cb_lock);
+  if (g_update_cb != NULL) {
+    g_update_cb(g_update_cb_data);
+  }
+  pthread_mutex_unlock(&g_update_cb_lock);
+}
+
 static char *find_char(char char_to_find, char *start_p, char *end_p, int skip) {
   char *ret = NULL;
 
@@ -247,9 +276,11 @@ static int parse_policy_struct(const char *p_policy, char **signed_policy_buff,
   char policy_signature_decoded[POLICY_LOADER_SIGNATURE_LEN] = {0};
   int policy_signature_len = 0;
   int policy_retrieved = 0;
+  jsmntok_t t[POLICY_LOADER_TOK_NUM];
+  jsonparser_ctx_t parser;
 
-  jsmn_init(&p);
-  r = jsmn_parse(&p, p_policy, strlen(p_policy), t, POLICY_LOADER_TOK_NUM);
+  jsonparser_init(&parser, t, POLICY_LOADER_TOK_NUM);
+  int r = jsonparser_parse(&parser, p_policy, strlen(p_policy));
 
   if (r < 0) {
     log_error(policy_loader_logger_id, "[%s:%d] Failed to parse policy JSON: %d\n", __func__, __LINE__, r);
@@ -265,28 +296,23 @@ static int parse_policy_struct(const char *p_policy, char **signed_policy_buff,
   if (memcmp(p_policy + t[1].start, "error", strlen("error")) == 0) {
     log_error(policy_loader_logger_id, "[%s:%d] Policy not found!\n", __func__, __LINE__);
   } else {
-    for (int i = 0; i < r; i++) {
-      if (memcmp(p_policy + t[i].start, "signature", strlen("signature")) == 0 &&
-          (t[i].end - t[i].start) == strlen("signature")) {
-        policy_signature_len = t[i + 1].end - t[i + 1].start;
-        policy_signature_buff = calloc(policy_signature_len + 1, 1);
-        memcpy(policy_signature_buff, p_policy + t[i + 1].start, policy_signature_len);
-        if (!b64_decode(policy_signature_buff, policy_signature_len, policy_signature_decoded,
-                        POLICY_LOADER_SIGNATURE_LEN))
-          return 0;
-        policy_retrieved++;
-        break;
-      }
+    int signature = jsonparser_get_value(&parser, 0, "signature");
+    if (signature != -1) {
+      policy_signature_len = t[signature].end - t[signature].start;
+      policy_signature_buff = calloc(policy_signature_len + 1, 1);
+      memcpy(policy_signature_buff, p_policy + t[signature].start, policy_signature_len);
+      if (!b64_decode(policy_signature_buff, policy_signature_len, policy_signature_decoded,
+                      POLICY_LOADER_SIGNATURE_LEN))
+        return 0;
+      policy_retrieved++;
     }
-    for (int i = 0; i < r; i++) {
-      if (memcmp(p_policy + t[i].start, "policy", strlen("policy")) == 0 &&
-          (t[i].end - t[i].start) == strlen("policy")) {
-        policy_len = t[i + 1].end - t[i + 1].start;
-        policy_buff = calloc(policy_len + 1, 1);
-        memcpy(policy_buff, p_policy + t[i + 1].start, policy_len);
-        policy_retrieved++;
-        break;
-      }
+
+    int policy = jsonparser_get_value(&parser, 0, "policy");
+    if (policy != -1) {
+      policy_len = t[policy].end - t[policy].start;
+      policy_buff = calloc(policy_len + 1, 1);
+      memcpy(policy_buff, p_policy + t[policy].start, policy_len);
+      policy_retrieved++;
     }
   }
 
@@ -308,28 +334,106 @@ static char g_policy_store_version[POLICY_LOADER_STR_LEN] = "0x0";
 static char g_device_id[POLICY_LOADER_STR_LEN] = "123";
 
 static int num_of_policies = 0;
+// Token index of the first policy ID to download, in the full list or in the "added" array of a delta.
+static int g_policy_ids_idx = POLICY_LOADER_ARRAY_TOK_IDX + 1;
+
+// Only changes since the device's policy store version are asked for. A delta request answered
+// with something else than a delta is followed by one full list request, then deltas are tried again.
+static int g_delta_sync = 1;
+static int g_full_sync = 0;
+
+// The version is compared as a whole buffer, so the bytes after the ID are cleared as well.
+static void store_policy_store_version(jsonparser_ctx_t *parser) {
+  int ps_id = jsonparser_get_value(parser, 0, "policyStoreId");
+  if (ps_id != -1) {
+    int len = parser->tokens[ps_id].end - parser->tokens[ps_id].start;
+
+    len = len < POLICY_LOADER_STR_LEN - 1 ? len : POLICY_LOADER_STR_LEN - 1;
+    memset(g_policy_store_version, 0, POLICY_LOADER_STR_LEN);
+    memcpy(g_policy_store_version, g_policy_list + parser->tokens[ps_id].start, len);
+  }
+}
+
+// Returns 1 if the token at idx is an array holding only policy ID strings.
+static int is_policy_id_array(jsonparser_ctx_t *parser, int idx) {
+  if (idx < 0 || parser->tokens[idx].type != JSMN_ARRAY || idx + parser->tokens[idx].size >= parser->num_of_tokens) {
+    return 0;
+  }
+
+  for (int i = 1; i <= parser->tokens[idx].size; i++) {
+    if (parser->tokens[idx + i].type != JSMN_STRING) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+// Revoked policies are deleted from the PAP right away, added ones are downloaded by receive_policies.
+static void apply_policy_delta(jsonparser_ctx_t *parser, int response) {
+  int added = jsonparser_get_value(parser, response, "added");
+  int revoked = jsonparser_get_value(parser, response, "revoked");
+  int removed = 0;
+
+  if (is_policy_id_array(parser, revoked)) {
+    for (int i = 1; i <= parser->tokens[revoked].size; i++) {
+      jsmntok_t *id = &parser->tokens[revoked + i];
+
+      if (pap_remove_policy(g_policy_list + id->start, id->end - id->start) == PAP_ERROR) {
+        log_error(policy_loader_logger_id, "[%s:%d] could not remove policy %.*s.\n", __func__, __LINE__,
+                  id->end - id->start, g_policy_list + id->start);
+      } else {
+        removed++;
+      }
+    }
+  }
+
+  if (is_policy_id_array(parser, added)) {
+    g_policy_ids_idx = added + 1;
+    num_of_policies = parser->tokens[added].size;
+  }
+
+  log_info(policy_loader_logger_id, "[%s:%d] policy delta: %d added, %d revoked.\n", __func__, __LINE__,
+           num_of_policies, removed);
+  store_policy_store_version(parser);
+
+  if (removed) {
+    notify_update();
+  }
+}
 
 static void parse_policy_service_list() {
-  int policy_list = jsonhelper_parser_init(g_policy_list);
+  jsonparser_ctx_t *parser = &g_policy_list_parser;
+  int was_delta = g_delta_sync && !g_full_sync;
+
+  g_full_sync = 0;
+
+  jsonparser_init(parser, g_policy_list_tokens, POLICY_LOADER_TOK_NUM);
+  int policy_list = jsonparser_parse(parser, g_policy_list, strlen(g_policy_list));
 
   if (policy_list > 0) {
-    int response = jsonhelper_get_value(g_policy_list, 0, "response");
+    int response = jsonparser_get_value(parser, 0, "response");
     if (response != -1) {
-      int response_type = jsonhelper_get_token_type(response);
+      int response_type = parser->tokens[response].type;
       if (response_type == POLICY_LOADER_POL_RESPONSE_TYPE_ARRAY) {
         // should resolve policyID list
-        num_of_policies = jsonhelper_array_size(POLICY_LOADER_ARRAY_TOK_IDX);
+        g_policy_ids_idx = POLICY_LOADER_ARRAY_TOK_IDX + 1;
+        num_of_policies = parser->tokens[POLICY_LOADER_ARRAY_TOK_IDX].size;
 
-        int ps_id = jsonhelper_get_value(g_policy_list, 0, "policyStoreId");
-        memcpy(g_policy_store_version, g_policy_list + jsonhelper_get_token_start(ps_id), POLICY_LOADER_STR_LEN - 1);
-        memcpy(g_policy_store_version + (POLICY_LOADER_STR_LEN - 1), "\0", 1);
+        store_policy_store_version(parser);
+      } else if (response_type == JSMN_OBJECT) {
+        apply_policy_delta(parser, response);
       } else if (response_type == POLICY_LOADER_POL_RESPONSE_TYPE_STRING) {
-        if (memcmp(g_policy_list + jsonhelper_get_token_start(response), "ok", strlen("ok")) == 0) {
+        if (memcmp(g_policy_list + parser->tokens[response].start, "ok", strlen("ok")) == 0) {
           log_info(policy_loader_logger_id, "[%s:%d] policy store up to date.\n", __func__, __LINE__);
         } else {
           log_error(policy_loader_logger_id, "[%s:%d] unkonwn response!\n", __func__, __LINE__);
         }
       }
+    } else if (was_delta) {
+      log_info(policy_loader_logger_id, "[%s:%d] no policy delta received, using the full list.\n", __func__,
+               __LINE__);
+      g_full_sync = 1;
     } else {
       char buf[POLICY_LOADER_TIME_BUF_LEN];
 
@@ -367,32 +471,114 @@ static unsigned int fsm_get_policy_list_done(void) {
   return ret;
 }
 
+// Adds one signed policy as sent by the policy store, returns 1 if it was added.
+static int add_policy(const char *p_policy, char *owner_public_key) {
+  char *policy_buff = NULL;
+  size_t policy_len = 0;
+  int added = 0;
+
+  if (parse_policy_struct(p_policy, &policy_buff, &policy_len) == 1) {
+    pap_add_policy(policy_buff, policy_len, NULL, owner_public_key);
+    added = 1;
+  }
+  if (policy_buff != NULL) {
+    free(policy_buff);
+  }
+
+  return added;
+}
+
+// Downloads the policies of count list entries, starting at first, in one request. Returns the
+// number of policies added, or -1 if the store did not answer with an array of policies.
+static int receive_policy_batch(int first, int count, char *owner_public_key) {
+  const char **policy_ids = malloc(count * sizeof(char *));
+  int *policy_id_lens = malloc(count * sizeof(int));
+  int policies_len = count * POLICY_LOADER_REPLY_POLICY_SIZE;
+  char *policies = malloc(policies_len);
+  jsmntok_t *t = malloc(count * POLICY_LOADER_TOK_NUM * sizeof(jsmntok_t));
+  jsonparser_ctx_t parser;
+  int added = -1;
+
+  if (policy_ids == NULL || policy_id_lens == NULL || policies == NULL || t == NULL) {
+    goto done;
+  }
+
+  for (int i = 0; i < count; i++) {
+    jsmntok_t *id = &g_policy_list_parser.tokens[g_policy_ids_idx + first + i];
+    policy_ids[i] = g_policy_list + id->start;
+    policy_id_lens[i] = id->end - id->start;
+  }
+
+  if (policyupdater_get_policies(policy_ids, policy_id_lens, count, policies, policies_len) != 0) {
+    goto done;
+  }
+
+  jsonparser_init(&parser, t, count * POLICY_LOADER_TOK_NUM);
+  int num_of_tokens = jsonparser_parse(&parser, policies, strlen(policies));
+  int array = num_of_tokens > 0 && t[0].type == JSMN_OBJECT ? jsonparser_get_value(&parser, 0, "response") : 0;
+  if (num_of_tokens < 1 || array < 0 || t[array].type != JSMN_ARRAY) {
+    goto done;
+  }
+
+  // Every element is a signed policy object, parsed on its own like a get_policy response.
+  added = 0;
+  for (int i = array + 1, element = 0; i < num_of_tokens && element < t[array].size; element++) {
+    jsmntok_t policy = t[i];
+    char end = policies[policy.end];
+
+    policies[policy.end] = '\0';
+    added += add_policy(policies + policy.start, owner_public_key);
+    policies[policy.end] = end;
+
+    while (i < num_of_tokens && t[i].start < policy.end) {
+      i++;
+    }
+  }
+
+done:
+  free(policy_ids);
+  free(policy_id_lens);
+  free(policies);
+  free(t);
+
+  return added;
+}
+
 static unsigned int receive_policies(void) {
   unsigned int ret = POLICY_LOADER_ERROR;
   char owner_public_key[POLICY_LOADER_PUBLIC_KEY_LEN] = {0};
-  char *policy_buff = NULL;
-  int policy_len = 0;
-  int status = 0;
+  int added = 0;
 
-  while (num_of_policies > 0) {
-    int current_policy = num_of_policies - 1;
+  if (num_of_policies > 0 && !b64_decode(g_owner_public_key, POLICY_LOADER_PUBLIC_KEY_B64_LEN, owner_public_key,
+                                         POLICY_LOADER_PUBLIC_KEY_LEN)) {
+    return 0;
+  }
 
-    policyupdater_get_policy(g_policy_list + jsonhelper_get_token_start(3 + current_policy), g_policy);
-    int status = parse_policy_struct(g_policy, &policy_buff, &policy_len);
-    if (status == 1) {
-      if (!b64_decode(g_owner_public_key, POLICY_LOADER_PUBLIC_KEY_B64_LEN, owner_public_key,
-                      POLICY_LOADER_PUBLIC_KEY_LEN))
-        return 0;
-      pap_add_policy(policy_buff, policy_len, NULL, owner_public_key);
-    }
-    if (policy_buff != NULL) {
-      free(policy_buff);
+  while (num_of_policies > 0) {
+    int count = MIN(num_of_policies, g_policy_batch_len);
+    int first = num_of_policies - count;
+    int batch_added = count > 1 ? receive_policy_batch(first, count, owner_public_key) : -1;
+
+    // A store without get_policies, or a single policy, is served one policy per request.
+    if (batch_added < 0) {
+      batch_added = 0;
+      for (int current_policy = first + count - 1; current_policy >= first; current_policy--) {
+        policyupdater_get_policy(g_policy_list + g_policy_list_parser.tokens[g_policy_ids_idx + current_policy].start,
+                                 g_policy);
+        batch_added += add_policy(g_policy, owner_public_key);
+      }
     }
 
-    num_of_policies -= 1;
+    added += batch_added;
+    num_of_policies -= count;
 
     ret = POLICY_LOADER_GET_PSS;
   }
+
+  if (added) {
+    notify_update();
+  }
+
   return ret;
 }
 
@@ -413,8 +599,13 @@ static int cycle_fsm() {
 
   switch (g_policy_updater_fsm_state) {
     case POLICY_LOADER_GET_PL:
-      policyupdater_get_policy_list(g_policy_store_version, g_device_id, g_policy_list, &g_policy_list_len,
-                                    &g_new_policy_list);
+      if (g_delta_sync && !g_full_sync) {
+        policyupdater_get_policy_delta(g_policy_store_version, g_device_id, g_policy_list, &g_policy_list_len,
+                                       &g_new_policy_list);
+      } else {
+        policyupdater_get_policy_list(g_policy_store_version, g_device_id, g_policy_list, &g_policy_list_len,
+                                      &g_new_policy_list);
+      }
       next_state = POLICY_LOADER_GET_PL_DONE;
       break;
     case POLICY_LOADER_GET_PL_DONE:
@@ -433,6 +624,37 @@ static int cycle_fsm() {
   return 0;
 }
 
+// Runs one full sync: the list or delta request, then the policy downloads. Returns 1 if the
+// policy store version changed.
+static int sync_policies(void) {
+  char version[POLICY_LOADER_STR_LEN];
+
+  memcpy(version, g_policy_store_version, POLICY_LOADER_STR_LEN);
+
+  if (g_policy_updater_fsm_state == POLICY_LOADER_INIT) {
+    cycle_fsm();
+  }
+  cycle_fsm();
+  cycle_fsm();
+
+  return memcmp(version, g_policy_store_version, POLICY_LOADER_STR_LEN) != 0;
+}
+
+static int subscribe(void) {
+  if (!g_subscribe) {
+    return 0;
+  }
+
+  return policyupdater_subscribe(g_policy_store_version, g_device_id, g_subscribe_timeout_ms) == 0;
+}
+
+static long long get_time_ms() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
 static void *policy_loader_thread_function(void *arg);
 
 int policyloader_start() {
@@ -442,6 +664,25 @@ int policyloader_start() {
   // Owner's public key should be stored on device, after owner is assigned to a device
   config_manager_get_option_string("config", "owner_public_key", g_owner_public_key,
                                    POLICY_LOADER_PUBLIC_KEY_B64_LEN + 1);
+  config_manager_get_option_int("pap", "policy_delta_sync", &g_delta_sync);
+  if (CONFIG_MANAGER_OK != config_manager_get_option_int("pap", "policy_batch_len", &g_policy_batch_len) ||
+      g_policy_batch_len < 1) {
+    g_policy_batch_len = POLICY_LOADER_DEFAULT_BATCH_LEN;
+  }
+  config_manager_get_option_int("pap", "policy_subscribe", &g_subscribe);
+  if (CONFIG_MANAGER_OK !=
+          config_manager_get_option_int("pap", "policy_subscribe_timeout_ms", &g_subscribe_timeout_ms) ||
+      g_subscribe_timeout_ms < 1) {
+    g_subscribe_timeout_ms = POLICY_LOADER_DEFAULT_SUBSCRIBE_TIMEOUT_MS;
+  }
+  if (CONFIG_MANAGER_OK != config_manager_get_option_int("pap", "policy_poll_min_ms", &g_poll_min_ms) ||
+      g_poll_min_ms < 1) {
+    g_poll_min_ms = POLICY_LOADER_DEFAULT_POLL_MIN_MS;
+  }
+  if (CONFIG_MANAGER_OK != config_manager_get_option_int("pap", "policy_poll_max_ms", &g_poll_max_ms) ||
+      g_poll_max_ms < g_poll_min_ms) {
+    g_poll_max_ms = MAX(g_poll_min_ms, POLICY_LOADER_DEFAULT_POLL_MAX_MS);
+  }
 
   g_end = 0;
   pthread_create(&g_thread, NULL, policy_loader_thread_function, NULL);
@@ -452,19 +693,80 @@ int policyloader_start() {
   return 0;
 }
 
+void policyloader_set_update_cb(policyloader_update_cb cb, void *user_data) {
+  pthread_mutex_lock(&g_update_cb_lock);
+  g_update_cb = cb;
+  g_update_cb_data = user_data;
+  pthread_mutex_unlock(&g_update_cb_lock);
+}
+
 int policyloader_stop() {
   g_end = 1;
   pthread_join(g_thread, NULL);
+  policyupdater_stop();
   return 0;
 }
 
+// Time of the next subscription attempt, the retry interval doubles up to g_poll_max_ms.
+static long long subscribe_backoff(int *retry_ms) {
+  long long next_ms = get_time_ms() + *retry_ms;
+
+  *retry_ms = MIN(*retry_ms * 2, g_poll_max_ms);
+  return next_ms;
+}
+
 static void *policy_loader_thread_function(void *arg) {
-  int period_counter = 0;
+  int poll_interval_ms = g_poll_min_ms;
+  long long next_poll_ms = 0;
+  int subscribed = 0;
+  // A store that drops subscriptions right away is not asked again at once. The retries back off
+  // and start over once a subscription delivered a notification.
+  int subscribe_retry_ms = g_poll_min_ms;
+  long long next_subscribe_ms = 0;
+
   while (!g_end) {
-    if (period_counter++ == (5000000 / g_task_sleep_time) || (5000000 / g_task_sleep_time) == 0) {  // 5 seconds
-      period_counter = 0;
-      cycle_fsm();
+    if (subscribed) {
+      switch (policyupdater_wait_for_update(POLICY_LOADER_WAIT_SLICE_MS)) {
+        case POLICYUPDATER_SUB_CHANGED:
+          subscribe_retry_ms = g_poll_min_ms;
+          sync_policies();
+          subscribed = subscribe();
+          break;
+        case POLICYUPDATER_SUB_EXPIRED:
+          subscribe_retry_ms = g_poll_min_ms;
+          subscribed = subscribe();
+          break;
+        case POLICYUPDATER_SUB_LOST:
+          log_info(policy_loader_logger_id, "[%s:%d] subscription lost, polling.\n", __func__, __LINE__);
+          subscribed = 0;
+          break;
+        default:
+          break;
+      }
+
+      if (!subscribed) {
+        next_subscribe_ms = subscribe_backoff(&subscribe_retry_ms);
+      }
+      continue;
+    }
+
+    // The poll schedule is kept while subscriptions come and go.
+    if (get_time_ms() >= next_poll_ms) {
+      poll_interval_ms = sync_policies() ? g_poll_min_ms : MIN(poll_interval_ms * 2, g_poll_max_ms);
+      next_poll_ms = get_time_ms() + poll_interval_ms;
     }
+
+    if (get_time_ms() >= next_subscribe_ms) {
+      subscribed = subscribe();
+      if (!subscribed) {
+        next_subscribe_ms = subscribe_backoff(&subscribe_retry_ms);
+      }
+    }
+
     usleep(g_task_sleep_time);
   }
+
+  policyupdater_unsubscribe();
+
+  return NULL;
 }
@@ -20,7 +20,10 @@
 #ifndef _POLICY_LOADER_H_
 #define _POLICY_LOADER_H_
 
+typedef void (*policyloader_update_cb)(void *user_data);
+
 int policyloader_start();
 int policyloader_stop();
+void policyloader_set_update_cb(policyloader_update_cb cb, void *user_data);
 
 #endif
@@ -21,10 +21,16 @@
 #include "policy_updater_logger.h"
 
 #include <arpa/inet.h>
+#include <errno.h>
 #include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/uio.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "config_manager.h"
@@ -32,7 +38,7 @@
 #include "time_manager.h"
 #include "utils.h"
 
-#define RECV_BUFF_LEN 1024
+#define RECV_BUFF_LEN 4096
 #define BUFF_LEN 80
 
 #define POLICY_UPDATER_REQ_GET_LIST_SIZE (256)
@@ -51,6 +57,32 @@
 #define POLICY_UPDATER_POL_ID_BUF_LEN 64
 #define POLICY_UPDATER_RESPONSE_LEN 2048
 #define POLICY_UPDATER_SERV_ADDR_LEN 100
+#define POLICY_UPDATER_SOCKET_TIMEOUT_S 5
+#define POLICY_UPDATER_FRAMING_LEN 16
+#define POLICY_UPDATER_LENGTH_PREFIX_LEN 4
+#define POLICY_UPDATER_MAX_MESSAGE_LEN (1024 * 1024)
+
+// How a message ends on the connection to the policy store. In the default mode the store sends
+// one JSON value per response, which ends at its closing bracket or at EOF.
+typedef enum {
+  POLICY_UPDATER_FRAMING_JSON = 0,
+  POLICY_UPDATER_FRAMING_LENGTH,   // 4 byte big endian length, then the message
+  POLICY_UPDATER_FRAMING_NEWLINE,  // the message, then '\n'
+} policyupdater_framing_e;
+
+// Received bytes not yet handed out. Reads go in RECV_BUFF_LEN chunks and the buffer grows up to
+// POLICY_UPDATER_MAX_MESSAGE_LEN, so a message takes a few reads whatever its size.
+typedef struct {
+  char *data;
+  int cap;
+  int start;
+  int end;
+} policyupdater_reader_t;
+
+typedef struct {
+  int fd;
+  policyupdater_reader_t reader;
+} policyupdater_conn_t;
 
 static char g_policy_updater_address[POLICY_UPDATER_ADDRESS_SIZE] = "\0";
 static int g_policy_updater_port = 6007;
@@ -60,28 +92,187 @@ static int g_user_port = 9998;
 
 static char g_module_name[] = "PolicyUpdater";
 
+// One connection to the policy store is kept open between requests, so a sync cycle does not pay
+// for a DNS lookup and a TCP handshake per request. It is reopened whenever the store closed it.
+static int g_keep_alive = 1;
+static policyupdater_conn_t g_store = {-1};
+static pthread_mutex_t g_store_lock = PTHREAD_MUTEX_INITIALIZER;
+static policyupdater_framing_e g_framing = POLICY_UPDATER_FRAMING_JSON;
+
+// The subscription waits on a connection of its own, so requests are never queued behind it. Only
+// the policy loader thread uses it.
+static policyupdater_conn_t g_subscription = {-1};
+static long long g_subscription_deadline_ms = 0;
+
 static int hostname_to_ip(const char *hostname, char *ip_address);
 
-static ssize_t read_socket(void *ext, void *data, unsigned short len) {
+static ssize_t read_socket(void *ext, void *data, size_t len) {
   int *sockfd = (int *)ext;
   return read(*sockfd, data, len);
 }
 
-static ssize_t write_socket(void *ext, void *data, unsigned short len) {
+static ssize_t write_socket(void *ext, void *data, size_t len) {
   int *sockfd = (int *)ext;
-  return write(*sockfd, data, len);
+  return send(*sockfd, data, len, MSG_NOSIGNAL);
+}
+
+// Sends the request framed like the responses, in one system call.
+static ssize_t write_request(int *sockfd, char *msg, int msg_length) {
+  unsigned char prefix[POLICY_UPDATER_LENGTH_PREFIX_LEN] = {msg_length >> 24, msg_length >> 16, msg_length >> 8,
+                                                           msg_length};
+  struct iovec iov[3] = {{NULL, 0}, {msg, msg_length}, {NULL, 0}};
+  struct msghdr header = {0};
+
+  if (g_framing == POLICY_UPDATER_FRAMING_JSON) {
+    return write_socket(sockfd, msg, msg_length);
+  } else if (g_framing == POLICY_UPDATER_FRAMING_LENGTH) {
+    iov[0].iov_base = prefix;
+    iov[0].iov_len = POLICY_UPDATER_LENGTH_PREFIX_LEN;
+  } else {
+    iov[2].iov_base = "\n";
+    iov[2].iov_len = 1;
+  }
+
+  header.msg_iov = iov;
+  header.msg_iovlen = 3;
+  ssize_t sent = sendmsg(*sockfd, &header, MSG_NOSIGNAL);
+
+  return sent == (ssize_t)(iov[0].iov_len + msg_length + iov[2].iov_len) ? msg_length : -1;
+}
+
+// Returns the length of the first complete message in data, or -1 if more bytes are needed.
+// *skip is the number of bytes around the message that belong to the frame.
+static int frame_length(const char *data, int len, int *skip) {
+  *skip = 0;
+
+  if (g_framing == POLICY_UPDATER_FRAMING_LENGTH) {
+    if (len < POLICY_UPDATER_LENGTH_PREFIX_LEN) {
+      return -1;
+    }
+
+    const unsigned char *prefix = (const unsigned char *)data;
+    uint32_t msg_len = ((uint32_t)prefix[0] << 24) | (prefix[1] << 16) | (prefix[2] << 8) | prefix[3];
+    if (msg_len > POLICY_UPDATER_MAX_MESSAGE_LEN || len - POLICY_UPDATER_LENGTH_PREFIX_LEN < (int)msg_len) {
+      return -1;
+    }
+
+    *skip = POLICY_UPDATER_LENGTH_PREFIX_LEN;
+    return msg_len;
+  }
+
+  if (g_framing == POLICY_UPDATER_FRAMING_NEWLINE) {
+    const char *newline = memchr(data, '\n', len);
+    if (newline == NULL) {
+      return -1;
+    }
+
+    *skip = 1;
+    return newline - data;
+  }
+
+  int depth = 0;
+  int in_string = 0;
+  int escaped = 0;
+
+  for (int i = 0; i < len; i++) {
+    char c = data[i];
+
+    if (in_string) {
+      if (escaped) {
+        escaped = 0;
+      } else if (c == '\\') {
+        escaped = 1;
+      } else if (c == '"') {
+        in_string = 0;
+      }
+    } else if (c == '"') {
+      in_string = 1;
+    } else if (c == '{' || c == '[') {
+      depth++;
+    } else if ((c == '}' || c == ']') && --depth == 0) {
+      return i + 1;
+    }
+  }
+
+  return -1;
+}
+
+// Makes room for at least one more chunk: consumed bytes are dropped first, then the buffer grows.
+static int reader_reserve(policyupdater_reader_t *reader) {
+  if (reader->start > 0) {
+    memmove(reader->data, reader->data + reader->start, reader->end - reader->start);
+    reader->end -= reader->start;
+    reader->start = 0;
+  }
+
+  if (reader->cap - reader->end >= RECV_BUFF_LEN) {
+    return 0;
+  }
+
+  int cap = reader->cap ? reader->cap * 2 : RECV_BUFF_LEN;
+  if (cap > POLICY_UPDATER_MAX_MESSAGE_LEN + POLICY_UPDATER_FRAMING_LEN) {
+    log_error(policy_updater_logger_id, "[%s:%d] response longer than %d bytes.\n", __func__, __LINE__,
+              POLICY_UPDATER_MAX_MESSAGE_LEN);
+    return 1;
+  }
+
+  char *data = realloc(reader->data, cap);
+  if (data == NULL) {
+    return 1;
+  }
+  reader->data = data;
+  reader->cap = cap;
+
+  return 0;
 }
 
-static int get_tcp_response(void *ext, char *recv_buffer) {
-  int length = 0;
+static void reader_reset(policyupdater_reader_t *reader) {
+  reader->start = 0;
+  reader->end = 0;
+}
 
-  int num_of_chars = read_socket(ext, recv_buffer, 1);
+// Reads the next response into recv_buffer, which holds recv_buffer_len bytes. Returns the length
+// plus one, like strlen for the terminated string. *complete is 0 if the store closed the
+// connection before the message ended, then recv_buffer holds everything received.
+static int get_tcp_response(policyupdater_conn_t *conn, char *recv_buffer, int recv_buffer_len, int *complete) {
+  policyupdater_reader_t *reader = &conn->reader;
+  int skip = 0;
+  int length = -1;
 
-  while (num_of_chars == 1) {
-    length++;
-    num_of_chars = read_socket(ext, recv_buffer + length, 1);
+  *complete = 0;
+
+  while ((length = frame_length(reader->data + reader->start, reader->end - reader->start, &skip)) < 0) {
+    if (reader_reserve(reader) != 0) {
+      break;
+    }
+
+    ssize_t num_of_chars = read_socket(&conn->fd, reader->data + reader->end, reader->cap - reader->end);
+    if (num_of_chars <= 0) {
+      break;
+    }
+    reader->end += num_of_chars;
   }
 
+  const char *msg = reader->data + reader->start;
+  if (length >= 0) {
+    *complete = 1;
+    msg += g_framing == POLICY_UPDATER_FRAMING_LENGTH ? skip : 0;
+    reader->start += length + skip;
+  } else {
+    length = reader->end - reader->start;
+    reader_reset(reader);
+  }
+
+  if (length >= recv_buffer_len) {
+    log_error(policy_updater_logger_id, "[%s:%d] response of %d bytes truncated.\n", __func__, __LINE__, length);
+    length = recv_buffer_len - 1;
+  }
+
+  if (length > 0) {
+    memcpy(recv_buffer, msg, length);
+  } else {
+    length = 0;
+  }
   recv_buffer[length] = '\0';
 
   length++;
@@ -89,44 +280,104 @@ static int get_tcp_response(void *ext, char *recv_buffer) {
   return length;
 }
 
-static int tcp_send(char *msg, int msg_length, char *rec, int *rec_length, char *servip, int port) {
-  int sockfd = 0;
+static void store_disconnect(policyupdater_conn_t *conn) {
+  if (conn->fd >= 0) {
+    close(conn->fd);
+    conn->fd = -1;
+  }
+  reader_reset(&conn->reader);
+}
+
+// A kept connection the store closed meanwhile reads as EOF; anything but "no data yet" means it
+// cannot carry the next request.
+static int store_connection_alive(policyupdater_conn_t *conn) {
+  char c;
+  ssize_t ret = recv(conn->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
 
-  char recv_buff[RECV_BUFF_LEN];
+  return ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+static int store_connect(policyupdater_conn_t *conn) {
+  char servip[POLICY_UPDATER_SERV_ADDR_LEN];
   struct sockaddr_in serv_addr;
+  struct timeval tv = {POLICY_UPDATER_SOCKET_TIMEOUT_S, 0};
+
+  if (hostname_to_ip(g_policy_updater_address, servip) != 0) {
+    log_error(policy_updater_logger_id, "[%s:%d] could not resolve %s.\n", __func__, __LINE__,
+              g_policy_updater_address);
+    return 1;
+  }
 
-  memset(recv_buff, '0', sizeof(recv_buff));
-  if ((sockfd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0) {
+  if ((conn->fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0) {
     log_error(policy_updater_logger_id, "[%s:%d] could not create socket.\n", __func__, __LINE__);
     return 1;
   }
 
-  memset(&serv_addr, '0', sizeof(serv_addr));
+  memset(&serv_addr, 0, sizeof(serv_addr));
 
   serv_addr.sin_family = AF_INET;
-  serv_addr.sin_port = htons(port);
+  serv_addr.sin_port = htons(g_policy_updater_port);
 
   if (inet_pton(AF_INET, servip, &serv_addr.sin_addr) <= 0) {
+    store_disconnect(conn);
     return 1;
   }
 
-  if (connect(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
-    char buf[BUFF_LEN];
-
-    timemanager_get_time_string(buf, BUFF_LEN);
+  // Bounded, because a kept connection may wait for a response that never completes.
+  setsockopt(conn->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(conn->fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
 
+  if (connect(conn->fd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
     log_error(policy_updater_logger_id, "[%s:%d] connection with server failed.\n", __func__, __LINE__);
-
+    store_disconnect(conn);
     return 1;
   }
 
-  write_socket(&sockfd, msg, msg_length);
-  *rec_length = get_tcp_response(&sockfd, rec);
-  close(sockfd);
-
   return 0;
 }
 
+static int tcp_send(char *msg, int msg_length, char *rec, int rec_buffer_len, int *rec_length) {
+  int ret = 1;
+
+  pthread_mutex_lock(&g_store_lock);
+
+  // A reused connection may have been dropped by the store in a way only the request notices, so a
+  // request that fails on it is tried once more on a fresh connection.
+  for (int attempt = 0; attempt < 2 && ret != 0; attempt++) {
+    int reused = g_store.fd >= 0;
+    int complete = 0;
+
+    if (reused && !store_connection_alive(&g_store)) {
+      store_disconnect(&g_store);
+      reused = 0;
+    }
+
+    if (!reused && store_connect(&g_store) != 0) {
+      break;
+    }
+
+    if (write_request(&g_store.fd, msg, msg_length) != msg_length) {
+      store_disconnect(&g_store);
+      continue;
+    }
+
+    *rec_length = get_tcp_response(&g_store, rec, rec_buffer_len, &complete);
+    if (reused && *rec_length <= 1) {
+      store_disconnect(&g_store);
+      continue;
+    }
+
+    if (!complete || !g_keep_alive) {
+      store_disconnect(&g_store);
+    }
+    ret = 0;
+  }
+
+  pthread_mutex_unlock(&g_store_lock);
+
+  return ret;
+}
+
 void policyupdater_get_policy(char *policy_id, char *p_policy) {
   char policy_request[POLICY_UPDATER_REQ_GET_LIST_SIZE] = {
       0,
@@ -135,16 +386,35 @@ void policyupdater_get_policy(char *policy_id, char *p_policy) {
   log_info(policy_updater_logger_id, "[%s:%d] asking for policy %.*s\n", __func__, __LINE__, POLICY_UPDATER_POL_ID_BUF_LEN, policy_id);
   snprintf(policy_request, POLICY_UPDATER_REQ_GET_LIST_SIZE, "{\"cmd\":\"get_policy\",\"policyId\":\"%.*s\"}",
            POLICY_UPDATER_POL_ID_BUF_LEN, policy_id);
-  int response_length;
-  char response[POLICY_UPDATER_RESPONSE_LEN];
+  int response_length = 0;
+
+  if (tcp_send(policy_request, strlen(policy_request), p_policy, POLICY_UPDATER_RESPONSE_LEN, &response_length) != 0) {
+    p_policy[0] = '\0';
+  }
+}
 
-  char policy_service_address[POLICY_UPDATER_SERV_ADDR_LEN];
-  hostname_to_ip(g_policy_updater_address, policy_service_address);
+int policyupdater_get_policies(const char **policy_ids, const int *policy_id_lens, int count, char *policies,
+                               int policies_len) {
+  int request_len = POLICY_UPDATER_REQ_GET_LIST_SIZE + count * (POLICY_UPDATER_POL_ID_BUF_LEN + 3);
+  char *policy_request = malloc(request_len);
+  int response_length = 0;
 
-  tcp_send(policy_request, strlen(policy_request), response, &response_length, policy_service_address,
-           g_policy_updater_port);
+  if (policy_request == NULL) {
+    return 1;
+  }
 
-  strncpy(p_policy, response, MIN((response_length + 1), (POLICY_UPDATER_RESPONSE_LEN - 1)));
+  log_info(policy_updater_logger_id, "[%s:%d] asking for %d policies\n", __func__, __LINE__, count);
+  int position = snprintf(policy_request, request_len, "{\"cmd\":\"get_policies\",\"policyIds\":[");
+  for (int i = 0; i < count; i++) {
+    position += snprintf(policy_request + position, request_len - position, i ? ",\"%.*s\"" : "\"%.*s\"",
+                         MIN(policy_id_lens[i], POLICY_UPDATER_POL_ID_BUF_LEN), policy_ids[i]);
+  }
+  snprintf(policy_request + position, request_len - position, "]}");
+
+  int res = tcp_send(policy_request, strlen(policy_request), policies, policies_len, &response_length);
+  free(policy_request);
+
+  return res;
 }
 
 void policyupdater_init() {
@@ -158,11 +428,34 @@ void policyupdater_init() {
   config_manager_get_option_int("pap", "policy_store_service_port", &g_policy_updater_port);
   config_manager_get_option_string("pap", "user_ip", g_user_address, POLICY_UPDATER_ADDRESS_SIZE);
   config_manager_get_option_int("pap", "user_port", &g_user_port);
+  config_manager_get_option_int("pap", "policy_store_keep_alive", &g_keep_alive);
+
+  char framing[POLICY_UPDATER_FRAMING_LEN] = "json";
+  config_manager_get_option_string("pap", "policy_store_framing", framing, POLICY_UPDATER_FRAMING_LEN);
+  if (strcmp(framing, "length") == 0) {
+    g_framing = POLICY_UPDATER_FRAMING_LENGTH;
+  } else if (strcmp(framing, "newline") == 0) {
+    g_framing = POLICY_UPDATER_FRAMING_NEWLINE;
+  } else {
+    g_framing = POLICY_UPDATER_FRAMING_JSON;
+  }
 }
 
 int policyupdater_start() {}
 
-int policyupdater_stop() {}
+int policyupdater_stop() {
+  pthread_mutex_lock(&g_store_lock);
+  store_disconnect(&g_store);
+  free(g_store.reader.data);
+  memset(&g_store.reader, 0, sizeof(g_store.reader));
+  pthread_mutex_unlock(&g_store_lock);
+
+  policyupdater_unsubscribe();
+  free(g_subscription.reader.data);
+  memset(&g_subscription.reader, 0, sizeof(g_subscription.reader));
+
+  return 0;
+}
 
 static int hostname_to_ip(const char *hostname, char *ip_address) {
   struct hostent *he;
@@ -180,35 +473,116 @@ static int hostname_to_ip(const char *hostname, char *ip_address) {
     strcpy(ip_address, inet_ntoa(*addr_list[i]));
     return 0;
   }
+
+  return 1;
 }
 
-unsigned int policyupdater_get_policy_list(const char *policy_store_version, const char *device_id, char *policy_list,
-                                           int *policy_list_len, int *new_policy_list_flag) {
+// The full list and the delta share the request and the response handling, only cmd differs.
+static unsigned int request_policy_list(const char *cmd, const char *policy_store_version, const char *device_id,
+                                        char *policy_list, int *policy_list_len, int *new_policy_list_flag) {
   char policy_request[POLICY_UPDATER_REQ_GET_LIST_SIZE];
-  log_debug(policy_updater_logger_id, "[%s:%d] asking for policy list.\n", __func__, __LINE__);
+  log_debug(policy_updater_logger_id, "[%s:%d] asking for %s.\n", __func__, __LINE__, cmd);
   log_debug(policy_updater_logger_id, "[%s:%d] policy_store_version: %s\n", __func__, __LINE__, policy_store_version);
   log_debug(policy_updater_logger_id, "[%s:%d] device_id: %s\n", __func__, __LINE__, device_id);
   snprintf(policy_request, POLICY_UPDATER_REQ_GET_LIST_SIZE,
-           "{\"cmd\":\"get_policy_list\",\"policyStoreId\":\"%s\",\"deviceId\":\"%s\"}", policy_store_version,
-           device_id);
+           "{\"cmd\":\"%s\",\"policyStoreId\":\"%s\",\"deviceId\":\"%s\"}", cmd, policy_store_version, device_id);
 
   int response_length;
   char response[POLICY_UPDATER_RESPONSE_LEN];
 
-  char policy_service_address[POLICY_UPDATER_SERV_ADDR_LEN];
-  hostname_to_ip(g_policy_updater_address, policy_service_address);
-  int res = tcp_send(policy_request, strlen(policy_request), response, &response_length, policy_service_address,
-                     g_policy_updater_port);
+  int res = tcp_send(policy_request, strlen(policy_request), response, POLICY_UPDATER_RESPONSE_LEN, &response_length);
 
   if (res != 1) {
-    strncpy(policy_list, response, POLICY_UPDATER_RESPONSE_LEN);
+    memcpy(policy_list, response, response_length);
 
     *new_policy_list_flag = 1;
-    if (strlen(policy_list) >= POLICY_UPDATER_RESPONSE_LEN) {
-      policy_list[POLICY_UPDATER_RESPONSE_LEN - 1] = '\0';
-    }
-    *policy_list_len = strlen(policy_list);
+    *policy_list_len = response_length - 1;
   }
 
   return 0;
 }
+
+unsigned int policyupdater_get_policy_list(const char *policy_store_version, const char *device_id, char *policy_list,
+                                           int *policy_list_len, int *new_policy_list_flag) {
+  return request_policy_list("get_policy_list", policy_store_version, device_id, policy_list, policy_list_len,
+                             new_policy_list_flag);
+}
+
+unsigned int policyupdater_get_policy_delta(const char *policy_store_version, const char *device_id, char *delta,
+                                            int *delta_len, int *new_delta_flag) {
+  return request_policy_list("get_policy_delta", policy_store_version, device_id, delta, delta_len, new_delta_flag);
+}
+
+static long long get_time_ms() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int policyupdater_subscribe(const char *policy_store_version, const char *device_id, int timeout_ms) {
+  char request[POLICY_UPDATER_REQ_GET_LIST_SIZE];
+  int len = snprintf(request, POLICY_UPDATER_REQ_GET_LIST_SIZE,
+                     "{\"cmd\":\"subscribe\",\"policyStoreId\":\"%s\",\"deviceId\":\"%s\",\"timeoutMs\":%d}",
+                     policy_store_version, device_id, timeout_ms);
+
+  // The connection of the previous subscription is reused if the store kept it open.
+  if (g_subscription.fd >= 0 && !store_connection_alive(&g_subscription)) {
+    store_disconnect(&g_subscription);
+  }
+
+  if (g_subscription.fd < 0 && store_connect(&g_subscription) != 0) {
+    return 1;
+  }
+
+  if (write_request(&g_subscription.fd, request, len) != len) {
+    store_disconnect(&g_subscription);
+    return 1;
+  }
+
+  // The store answers by timeout_ms at the latest; a connection silent for longer is considered lost.
+  g_subscription_deadline_ms = get_time_ms() + timeout_ms + POLICY_UPDATER_SOCKET_TIMEOUT_S * 1000;
+
+  return 0;
+}
+
+policyupdater_sub_state_e policyupdater_wait_for_update(int wait_ms) {
+  struct pollfd pfd = {g_subscription.fd, POLLIN, 0};
+  char response[POLICY_UPDATER_REQ_GET_LIST_SIZE];
+  int complete = 0;
+
+  if (g_subscription.fd < 0) {
+    return POLICYUPDATER_SUB_LOST;
+  }
+
+  // Bytes already buffered count as readable, e.g. when the store answered with the previous response.
+  if (g_subscription.reader.end == g_subscription.reader.start) {
+    int ready = poll(&pfd, 1, wait_ms);
+
+    if (ready == 0 && get_time_ms() < g_subscription_deadline_ms) {
+      return POLICYUPDATER_SUB_WAITING;
+    } else if (ready <= 0) {
+      store_disconnect(&g_subscription);
+      return POLICYUPDATER_SUB_LOST;
+    }
+  }
+
+  get_tcp_response(&g_subscription, response, POLICY_UPDATER_REQ_GET_LIST_SIZE, &complete);
+  if (!complete || !g_keep_alive) {
+    store_disconnect(&g_subscription);
+  }
+
+  if (strstr(response, "\"changed\"") != NULL) {
+    return POLICYUPDATER_SUB_CHANGED;
+  } else if (complete && strstr(response, "\"ok\"") != NULL) {
+    return POLICYUPDATER_SUB_EXPIRED;
+  }
+
+  // An error or an unknown answer: the store does not support subscriptions.
+  log_info(policy_updater_logger_id, "[%s:%d] subscription not available.\n", __func__, __LINE__);
+  store_disconnect(&g_subscription);
+
+  return POLICYUPDATER_SUB_LOST;
+}
+
+void policyupdater_unsubscribe() { store_disconnect(&g_subscription); }
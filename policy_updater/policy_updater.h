@@ -20,11 +20,75 @@
 #ifndef _POLICY_UPDATER_H_
 #define _POLICY_UPDATER_H_
 
+typedef enum {
+  POLICYUPDATER_SUB_WAITING = 0,  // no answer from the store yet
+  POLICYUPDATER_SUB_CHANGED,      // the store has a newer version, subscribe again once synced
+  POLICYUPDATER_SUB_EXPIRED,      // the store ended the wait without a change, subscribe again
+  POLICYUPDATER_SUB_LOST,         // the subscription channel is not available, poll instead
+} policyupdater_sub_state_e;
+
 void policyupdater_init();
 
+int policyupdater_stop();
+
 void policyupdater_get_policy(char *policy_id, char *policy_buff);
 
+/**
+ * @brief Download several signed policies with one get_policies request
+ *
+ * @param policy_ids policy IDs, not terminated
+ * @param policy_id_lens length of every policy ID
+ * @param count number of policy IDs
+ * @param policies buffer for the response, an array of signed policies
+ * @param policies_len size of the policies buffer
+ * @return int 0 on success, 1 if the policy store could not be reached
+ */
+int policyupdater_get_policies(const char **policy_ids, const int *policy_id_lens, int count, char *policies,
+                               int policies_len);
+
 unsigned int policyupdater_get_policy_list(const char *policy_store_version, const char *device_id, char *policy_list,
                                            int *policy_list_len, int *new_policy_list_flag);
 
+/**
+ * @brief Ask for the policies added and revoked since a policy store version
+ *
+ * The response is {"response":{"added":[IDs],"revoked":[IDs]},"policyStoreId":version},
+ * or {"response":"ok"} when nothing changed.
+ *
+ * @param policy_store_version policy store version the device has
+ * @param device_id device ID
+ * @param delta buffer for the response, same size as for policyupdater_get_policy_list
+ * @param delta_len response length
+ * @param new_delta_flag set to 1 when a response was received
+ * @return unsigned int 0
+ */
+unsigned int policyupdater_get_policy_delta(const char *policy_store_version, const char *device_id, char *delta,
+                                            int *delta_len, int *new_delta_flag);
+
+/**
+ * @brief Ask the policy store to answer once its version differs from the given one
+ *
+ * The store answers {"response":"changed"} as soon as there is a newer version, or
+ * {"response":"ok"} if nothing changed within timeout_ms.
+ *
+ * @param policy_store_version policy store version the device has
+ * @param device_id device ID
+ * @param timeout_ms longest time the store holds the subscription
+ * @return int 0 on success, 1 if the policy store could not be reached
+ */
+int policyupdater_subscribe(const char *policy_store_version, const char *device_id, int timeout_ms);
+
+/**
+ * @brief Wait for the answer to the last subscription
+ *
+ * @param wait_ms longest time to block
+ * @return policyupdater_sub_state_e state of the subscription
+ */
+policyupdater_sub_state_e policyupdater_wait_for_update(int wait_ms);
+
+/**
+ * @brief Drop the subscription and close its connection
+ */
+void policyupdater_unsubscribe();
+
 #endif /* _POLICY_UPDATER_H_ */
@@ -0,0 +1,145 @@
+/*
+ * This file is part of the IOTA Access distribution
+ * (https://github.com/iotaledger/access)
+ *
+ * Copyright (c) 2020 IOTA Stiftung
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * \project IOTA Access
+ * \file test_json_parser.c
+ * \brief
+ * Unit tests for the JSON parser context
+ *
+ * \notes
+ *
+ * \history
+ * 16.10.2026. Initial version.
+ ****************************************************************************/
+
+#include <string.h>
+
+#include "unity/unity.h"
+
+#include "json_parser.h"
+
+#define TEST_MAX_TOKENS 32
+
+static jsmntok_t g_tokens[TEST_MAX_TOKENS];
+
+static int parse(jsonparser_ctx_t *parser, const char *json) {
+  jsonparser_init(parser, g_tokens, TEST_MAX_TOKENS);
+  return jsonparser_parse(parser, json, strlen(json));
+}
+
+static int token_is(jsonparser_ctx_t *parser, int idx, const char *text) {
+  jsmntok_t *tok = jsonparser_token(parser, idx);
+
+  return tok != NULL && tok->end - tok->start == (int)strlen(text) &&
+         memcmp(parser->json + tok->start, text, tok->end - tok->start) == 0;
+}
+
+void test_token_out_of_range(void) {
+  jsonparser_ctx_t parser;
+
+  TEST_ASSERT_EQUAL_INT(3, parse(&parser, "{\"cmd\":\"resolve\"}"));
+  TEST_ASSERT_NOT_NULL(jsonparser_token(&parser, 2));
+  TEST_ASSERT_NULL(jsonparser_token(&parser, 3));
+  TEST_ASSERT_NULL(jsonparser_token(&parser, -1));
+}
+
+void test_get_value(void) {
+  jsonparser_ctx_t parser;
+
+  TEST_ASSERT_GREATER_THAN(0, parse(&parser, "{\"cmd\":\"get_user\",\"username\":\"alice\"}"));
+  TEST_ASSERT_TRUE(token_is(&parser, jsonparser_get_value(&parser, 0, "username"), "alice"));
+  TEST_ASSERT_EQUAL_INT(-1, jsonparser_get_value(&parser, 0, "user"));
+  // Values are not keys.
+  TEST_ASSERT_EQUAL_INT(-1, jsonparser_get_value(&parser, 0, "alice"));
+  // Only an object has members.
+  TEST_ASSERT_EQUAL_INT(-1, jsonparser_get_value(&parser, 2, "username"));
+  TEST_ASSERT_EQUAL_INT(-1, jsonparser_get_value(&parser, parser.num_of_tokens, "username"));
+}
+
+void test_get_value_direct_members(void) {
+  jsonparser_ctx_t parser;
+  const char *json = "{\"user\":{\"policy\":\"inner\",\"ids\":[{\"signature\":1}]},\"signature\":\"outer\"}";
+
+  TEST_ASSERT_GREATER_THAN(0, parse(&parser, json));
+
+  // Keys of nested values are skipped, the direct member is found after them.
+  TEST_ASSERT_TRUE(token_is(&parser, jsonparser_get_value(&parser, 0, "signature"), "outer"));
+  TEST_ASSERT_EQUAL_INT(-1, jsonparser_get_value(&parser, 0, "policy"));
+  TEST_ASSERT_EQUAL_INT(-1, jsonparser_get_value(&parser, 0, "ids"));
+
+  // A nested object is searched when its own index is given.
+  int user = jsonparser_get_value(&parser, 0, "user");
+  TEST_ASSERT_TRUE(token_is(&parser, jsonparser_get_value(&parser, user, "policy"), "inner"));
+  TEST_ASSERT_EQUAL_INT(-1, jsonparser_get_value(&parser, user, "signature"));
+}
+
+void test_skip_nested_values(void) {
+  jsonparser_ctx_t parser;
+  const char *json = "{\"user\":{\"cmd\":\"x\",\"ids\":[1,[2,3]]},\"cmd\":\"resolve\"}";
+
+  int num_of_tokens = parse(&parser, json);
+  TEST_ASSERT_GREATER_THAN(0, num_of_tokens);
+
+  // The whole object, then the value of "user" with everything nested in it.
+  TEST_ASSERT_EQUAL_INT(num_of_tokens, jsonparser_skip(&parser, 0));
+  int next_key = jsonparser_skip(&parser, 2);
+  TEST_ASSERT_TRUE(token_is(&parser, next_key, "cmd"));
+  TEST_ASSERT_TRUE(token_is(&parser, next_key + 1, "resolve"));
+
+  // A key is skipped together with its value.
+  TEST_ASSERT_EQUAL_INT(next_key, jsonparser_skip(&parser, 1));
+
+  // The last value ends the tokens.
+  TEST_ASSERT_EQUAL_INT(num_of_tokens, jsonparser_skip(&parser, num_of_tokens - 1));
+}
+
+void test_skip_top_level_keys(void) {
+  jsonparser_ctx_t parser;
+  const char *keys[] = {"a", "b", "c"};
+  int idx = 1;
+
+  TEST_ASSERT_GREATER_THAN(0, parse(&parser, "{\"a\":[{\"b\":1}],\"b\":{\"c\":{}},\"c\":null}"));
+
+  for (int i = 0; i < 3; i++) {
+    TEST_ASSERT_TRUE(token_is(&parser, idx, keys[i]));
+    idx = jsonparser_skip(&parser, idx + 1);
+  }
+  TEST_ASSERT_EQUAL_INT(parser.num_of_tokens, idx);
+}
+
+void test_parse_errors(void) {
+  jsonparser_ctx_t parser;
+
+  TEST_ASSERT_LESS_THAN(0, parse(&parser, "{\"cmd\":\"resolve\""));
+  TEST_ASSERT_LESS_THAN(0, parse(&parser, "{\"cmd\":[1,2}"));
+}
+
+int main() {
+  UNITY_BEGIN();
+
+  RUN_TEST(test_token_out_of_range);
+  RUN_TEST(test_get_value);
+  RUN_TEST(test_get_value_direct_members);
+  RUN_TEST(test_skip_nested_values);
+  RUN_TEST(test_skip_top_level_keys);
+  RUN_TEST(test_parse_errors);
+
+  return UNITY_END();
+}
@@ -0,0 +1,116 @@
+/*
+ * This file is part of the IOTA Access distribution
+ * (https://github.com/iotaledger/access)
+ *
+ * Copyright (c) 2020 IOTA Stiftung
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * \project IOTA Access
+ * \file test_arena.c
+ * \brief
+ * Unit tests for the request arena
+ *
+ * \notes
+ *
+ * \history
+ * 16.10.2026. Initial version.
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "unity/unity.h"
+
+#include "arena.h"
+
+#define TEST_BLOCK_LEN 256
+
+void test_alloc_is_aligned(void) {
+  arena_t arena;
+  arena_init(&arena, TEST_BLOCK_LEN);
+
+  TEST_ASSERT_NULL(arena.first);
+  for (int len = 1; len < 40; len += 7) {
+    void *ptr = arena_alloc(&arena, len);
+    TEST_ASSERT_NOT_NULL(ptr);
+    TEST_ASSERT_EQUAL_INT(0, (uintptr_t)ptr % sizeof(long double));
+  }
+
+  arena_release(&arena);
+}
+
+void test_allocations_do_not_overlap(void) {
+  arena_t arena;
+  char *ptrs[8];
+  arena_init(&arena, TEST_BLOCK_LEN);
+
+  // Eight times 100 bytes spill over into extra blocks.
+  for (int i = 0; i < 8; i++) {
+    ptrs[i] = arena_alloc(&arena, 100);
+    TEST_ASSERT_NOT_NULL(ptrs[i]);
+    memset(ptrs[i], i, 100);
+  }
+  for (int i = 0; i < 8; i++) {
+    for (int j = 0; j < 100; j++) {
+      TEST_ASSERT_EQUAL_INT(i, ptrs[i][j]);
+    }
+  }
+
+  arena_release(&arena);
+}
+
+void test_large_alloc(void) {
+  arena_t arena;
+  arena_init(&arena, TEST_BLOCK_LEN);
+
+  char *ptr = arena_alloc(&arena, 4 * TEST_BLOCK_LEN);
+  TEST_ASSERT_NOT_NULL(ptr);
+  memset(ptr, 0xa5, 4 * TEST_BLOCK_LEN);
+  TEST_ASSERT_NOT_NULL(arena.extra);
+
+  arena_release(&arena);
+}
+
+void test_reset_keeps_first_block(void) {
+  arena_t arena;
+  arena_init(&arena, TEST_BLOCK_LEN);
+
+  char *first = arena_alloc(&arena, 64);
+  arena_alloc(&arena, 2 * TEST_BLOCK_LEN);
+  TEST_ASSERT_GREATER_OR_EQUAL(64 + 2 * TEST_BLOCK_LEN, arena.used);
+
+  arena_reset(&arena);
+  TEST_ASSERT_EQUAL_INT(0, arena.used);
+  TEST_ASSERT_NULL(arena.extra);
+  TEST_ASSERT_NOT_NULL(arena.first);
+
+  // The next request starts over at the beginning of the same block.
+  TEST_ASSERT_EQUAL_PTR(first, arena_alloc(&arena, 64));
+
+  arena_release(&arena);
+  TEST_ASSERT_NULL(arena.first);
+}
+
+int main() {
+  UNITY_BEGIN();
+
+  RUN_TEST(test_alloc_is_aligned);
+  RUN_TEST(test_allocations_do_not_overlap);
+  RUN_TEST(test_large_alloc);
+  RUN_TEST(test_reset_keeps_first_block);
+
+  return UNITY_END();
+}
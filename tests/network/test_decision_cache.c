@@ -0,0 +1,136 @@
+/*
+ * This file is part of the IOTA Access distribution
+ * (https://github.com/iotaledger/access)
+ *
+ * Copyright (c) 2020 IOTA Stiftung
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * \project IOTA Access
+ * \file test_decision_cache.c
+ * \brief
+ * Unit tests for the decision cache
+ *
+ * \notes
+ *
+ * \history
+ * 16.10.2026. Initial version.
+ ****************************************************************************/
+
+#include <string.h>
+
+#include "unity/unity.h"
+
+#include "decision_cache.h"
+
+#define TEST_TTL_MS 1000
+#define TEST_KEY_A "{\"cmd\":\"resolve\",\"policy_id\":\"a\"}"
+#define TEST_KEY_B "{\"cmd\":\"resolve\",\"policy_id\":\"b\"}"
+
+void test_create_invalid(void) {
+  TEST_ASSERT_NULL(decisioncache_create(0, TEST_TTL_MS));
+  TEST_ASSERT_NULL(decisioncache_create(16, 0));
+}
+
+void test_hit_and_miss(void) {
+  decisioncache_t *dc = decisioncache_create(16, TEST_TTL_MS);
+  int decision = -1;
+  TEST_ASSERT_NOT_NULL(dc);
+
+  TEST_ASSERT_EQUAL_INT(-1, decisioncache_get(dc, TEST_KEY_A, strlen(TEST_KEY_A), 0, &decision));
+
+  decisioncache_put(dc, TEST_KEY_A, strlen(TEST_KEY_A), decisioncache_version(dc), 0, 1);
+  TEST_ASSERT_EQUAL_INT(0, decisioncache_get(dc, TEST_KEY_A, strlen(TEST_KEY_A), 10, &decision));
+  TEST_ASSERT_EQUAL_INT(1, decision);
+  TEST_ASSERT_EQUAL_INT(-1, decisioncache_get(dc, TEST_KEY_B, strlen(TEST_KEY_B), 10, &decision));
+
+  // A key that is a prefix of a cached one is another key.
+  TEST_ASSERT_EQUAL_INT(-1, decisioncache_get(dc, TEST_KEY_A, strlen(TEST_KEY_A) - 1, 10, &decision));
+
+  decisioncache_destroy(dc);
+}
+
+void test_ttl(void) {
+  decisioncache_t *dc = decisioncache_create(16, TEST_TTL_MS);
+  int decision = -1;
+  TEST_ASSERT_NOT_NULL(dc);
+
+  decisioncache_put(dc, TEST_KEY_A, strlen(TEST_KEY_A), decisioncache_version(dc), 100, 0);
+  TEST_ASSERT_EQUAL_INT(0, decisioncache_get(dc, TEST_KEY_A, strlen(TEST_KEY_A), 100 + TEST_TTL_MS - 1, &decision));
+  TEST_ASSERT_EQUAL_INT(-1, decisioncache_get(dc, TEST_KEY_A, strlen(TEST_KEY_A), 100 + TEST_TTL_MS, &decision));
+
+  decisioncache_destroy(dc);
+}
+
+void test_invalidate(void) {
+  decisioncache_t *dc = decisioncache_create(16, TEST_TTL_MS);
+  int decision = -1;
+  TEST_ASSERT_NOT_NULL(dc);
+
+  decisioncache_put(dc, TEST_KEY_A, strlen(TEST_KEY_A), decisioncache_version(dc), 0, 1);
+  decisioncache_put(dc, TEST_KEY_B, strlen(TEST_KEY_B), decisioncache_version(dc), 0, 0);
+  decisioncache_invalidate(dc);
+
+  TEST_ASSERT_EQUAL_INT(-1, decisioncache_get(dc, TEST_KEY_A, strlen(TEST_KEY_A), 10, &decision));
+  TEST_ASSERT_EQUAL_INT(-1, decisioncache_get(dc, TEST_KEY_B, strlen(TEST_KEY_B), 10, &decision));
+
+  // Decisions stored after the invalidation are cached again.
+  decisioncache_put(dc, TEST_KEY_A, strlen(TEST_KEY_A), decisioncache_version(dc), 10, 0);
+  TEST_ASSERT_EQUAL_INT(0, decisioncache_get(dc, TEST_KEY_A, strlen(TEST_KEY_A), 20, &decision));
+  TEST_ASSERT_EQUAL_INT(0, decision);
+
+  decisioncache_destroy(dc);
+}
+
+void test_put_after_invalidate_is_dropped(void) {
+  decisioncache_t *dc = decisioncache_create(16, TEST_TTL_MS);
+  int decision = -1;
+  TEST_ASSERT_NOT_NULL(dc);
+
+  // A policy update lands while the decision is being evaluated.
+  unsigned version = decisioncache_version(dc);
+  decisioncache_invalidate(dc);
+  decisioncache_put(dc, TEST_KEY_A, strlen(TEST_KEY_A), version, 0, 1);
+
+  TEST_ASSERT_EQUAL_INT(-1, decisioncache_get(dc, TEST_KEY_A, strlen(TEST_KEY_A), 10, &decision));
+
+  decisioncache_destroy(dc);
+}
+
+void test_long_key_not_cached(void) {
+  char key[DECISIONCACHE_KEY_LEN];
+  decisioncache_t *dc = decisioncache_create(16, TEST_TTL_MS);
+  int decision = -1;
+  TEST_ASSERT_NOT_NULL(dc);
+
+  memset(key, 'k', sizeof(key));
+  decisioncache_put(dc, key, sizeof(key), decisioncache_version(dc), 0, 1);
+  TEST_ASSERT_EQUAL_INT(-1, decisioncache_get(dc, key, sizeof(key), 10, &decision));
+
+  decisioncache_destroy(dc);
+}
+
+int main() {
+  UNITY_BEGIN();
+
+  RUN_TEST(test_create_invalid);
+  RUN_TEST(test_hit_and_miss);
+  RUN_TEST(test_ttl);
+  RUN_TEST(test_invalidate);
+  RUN_TEST(test_put_after_invalidate_is_dropped);
+  RUN_TEST(test_long_key_not_cached);
+
+  return UNITY_END();
+}
@@ -0,0 +1,123 @@
+/*
+ * This file is part of the IOTA Access distribution
+ * (https://github.com/iotaledger/access)
+ *
+ * Copyright (c) 2020 IOTA Stiftung
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * \project IOTA Access
+ * \file test_rate_limiter.c
+ * \brief
+ * Unit tests for the per-key rate limiter
+ *
+ * \notes
+ *
+ * \history
+ * 16.10.2026. Initial version.
+ ****************************************************************************/
+
+#include "unity/unity.h"
+
+#include "rate_limiter.h"
+
+#define TEST_KEY_A 0x0a000001
+#define TEST_KEY_B 0x0a000002
+
+void test_create_invalid(void) {
+  TEST_ASSERT_NULL(ratelimiter_create(0, 10, 1));
+  TEST_ASSERT_NULL(ratelimiter_create(4, 0, 1));
+  TEST_ASSERT_NULL(ratelimiter_create(4, 10, 0));
+}
+
+void test_burst_then_throttle(void) {
+  ratelimiter_t *rl = ratelimiter_create(4, 10, 3);
+  TEST_ASSERT_NOT_NULL(rl);
+
+  for (int i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL_INT(0, ratelimiter_allow(rl, TEST_KEY_A, 1000));
+  }
+  // 10 tokens per second, the next one is 100 ms away.
+  TEST_ASSERT_EQUAL_INT(100, ratelimiter_allow(rl, TEST_KEY_A, 1000));
+  TEST_ASSERT_EQUAL_INT(40, ratelimiter_allow(rl, TEST_KEY_A, 1060));
+
+  // Other keys have their own bucket.
+  TEST_ASSERT_EQUAL_INT(0, ratelimiter_allow(rl, TEST_KEY_B, 1060));
+
+  ratelimiter_destroy(rl);
+}
+
+void test_refill(void) {
+  ratelimiter_t *rl = ratelimiter_create(4, 10, 2);
+  TEST_ASSERT_NOT_NULL(rl);
+
+  TEST_ASSERT_EQUAL_INT(0, ratelimiter_allow(rl, TEST_KEY_A, 0));
+  TEST_ASSERT_EQUAL_INT(0, ratelimiter_allow(rl, TEST_KEY_A, 0));
+  TEST_ASSERT_GREATER_THAN(0, ratelimiter_allow(rl, TEST_KEY_A, 50));
+  TEST_ASSERT_EQUAL_INT(0, ratelimiter_allow(rl, TEST_KEY_A, 100));
+  TEST_ASSERT_GREATER_THAN(0, ratelimiter_allow(rl, TEST_KEY_A, 100));
+
+  // A long pause refills no more than the burst.
+  for (int i = 0; i < 2; i++) {
+    TEST_ASSERT_EQUAL_INT(0, ratelimiter_allow(rl, TEST_KEY_A, 60000));
+  }
+  TEST_ASSERT_GREATER_THAN(0, ratelimiter_allow(rl, TEST_KEY_A, 60000));
+
+  ratelimiter_destroy(rl);
+}
+
+void test_throttled_key_is_not_evicted(void) {
+  ratelimiter_t *rl = ratelimiter_create(1, 10, 2);
+  TEST_ASSERT_NOT_NULL(rl);
+
+  TEST_ASSERT_EQUAL_INT(0, ratelimiter_allow(rl, TEST_KEY_A, 0));
+  TEST_ASSERT_EQUAL_INT(0, ratelimiter_allow(rl, TEST_KEY_A, 0));
+
+  // The only bucket is refilling, so a new key waits until it is full again.
+  TEST_ASSERT_EQUAL_INT(200, ratelimiter_allow(rl, TEST_KEY_B, 0));
+  TEST_ASSERT_EQUAL_INT(150, ratelimiter_allow(rl, TEST_KEY_B, 50));
+
+  // A key cannot get a fresh bucket by being pushed out, A is still throttled.
+  TEST_ASSERT_EQUAL_INT(50, ratelimiter_allow(rl, TEST_KEY_A, 50));
+
+  ratelimiter_destroy(rl);
+}
+
+void test_refilled_key_is_evicted(void) {
+  ratelimiter_t *rl = ratelimiter_create(1, 10, 2);
+  TEST_ASSERT_NOT_NULL(rl);
+
+  TEST_ASSERT_EQUAL_INT(0, ratelimiter_allow(rl, TEST_KEY_A, 0));
+  TEST_ASSERT_EQUAL_INT(0, ratelimiter_allow(rl, TEST_KEY_A, 0));
+
+  // Once the bucket of A is full, B takes it over with a full bucket of its own.
+  TEST_ASSERT_EQUAL_INT(0, ratelimiter_allow(rl, TEST_KEY_B, 200));
+  TEST_ASSERT_EQUAL_INT(0, ratelimiter_allow(rl, TEST_KEY_B, 200));
+  TEST_ASSERT_EQUAL_INT(100, ratelimiter_allow(rl, TEST_KEY_B, 200));
+
+  ratelimiter_destroy(rl);
+}
+
+int main() {
+  UNITY_BEGIN();
+
+  RUN_TEST(test_create_invalid);
+  RUN_TEST(test_burst_then_throttle);
+  RUN_TEST(test_refill);
+  RUN_TEST(test_throttled_key_is_not_evicted);
+  RUN_TEST(test_refilled_key_is_evicted);
+
+  return UNITY_END();
+}
@@ -0,0 +1,174 @@
+/*
+ * This file is part of the IOTA Access distribution
+ * (https://github.com/iotaledger/access)
+ *
+ * Copyright (c) 2020 IOTA Stiftung
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * \project IOTA Access
+ * \file test_single_flight.c
+ * \brief
+ * Unit tests for the single flight group
+ *
+ * \notes
+ *
+ * \history
+ * 16.10.2026. Initial version.
+ ****************************************************************************/
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "unity/unity.h"
+
+#include "single_flight.h"
+
+#define TEST_WAITERS 8
+#define TEST_KEY "{\"cmd\":\"resolve\",\"policy_id\":\"1\"}"
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_changed = PTHREAD_COND_INITIALIZER;
+static int g_gate_open;
+static int g_runs;
+
+typedef struct {
+  singleflight_t *sf;
+  int result;
+  int shared;
+} test_caller_t;
+
+static int count_run(void *arg) {
+  pthread_mutex_lock(&g_lock);
+  g_runs++;
+  pthread_mutex_unlock(&g_lock);
+
+  return *(int *)arg;
+}
+
+// Holds the run in flight until the gate opens.
+static int gated_run(void *arg) {
+  pthread_mutex_lock(&g_lock);
+  g_runs++;
+  pthread_cond_broadcast(&g_changed);
+  while (!g_gate_open) {
+    pthread_cond_wait(&g_changed, &g_lock);
+  }
+  pthread_mutex_unlock(&g_lock);
+
+  return 42;
+}
+
+static void *caller_thread(void *ptr) {
+  test_caller_t *caller = (test_caller_t *)ptr;
+
+  caller->result = singleflight_do(caller->sf, TEST_KEY, strlen(TEST_KEY), gated_run, NULL, &caller->shared);
+
+  return NULL;
+}
+
+void test_create_invalid(void) { TEST_ASSERT_NULL(singleflight_create(0)); }
+
+void test_concurrent_calls_share_one_run(void) {
+  test_caller_t callers[TEST_WAITERS + 1];
+  pthread_t threads[TEST_WAITERS + 1];
+  singleflight_t *sf = singleflight_create(4);
+  TEST_ASSERT_NOT_NULL(sf);
+
+  g_runs = 0;
+  g_gate_open = 0;
+
+  callers[0].sf = sf;
+  TEST_ASSERT_EQUAL_INT(0, pthread_create(&threads[0], NULL, caller_thread, &callers[0]));
+
+  pthread_mutex_lock(&g_lock);
+  while (g_runs == 0) {
+    pthread_cond_wait(&g_changed, &g_lock);
+  }
+  pthread_mutex_unlock(&g_lock);
+
+  for (int i = 1; i <= TEST_WAITERS; i++) {
+    callers[i].sf = sf;
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&threads[i], NULL, caller_thread, &callers[i]));
+  }
+
+  // Give the waiters time to join the run in flight before it finishes.
+  usleep(100 * 1000);
+  pthread_mutex_lock(&g_lock);
+  g_gate_open = 1;
+  pthread_cond_broadcast(&g_changed);
+  pthread_mutex_unlock(&g_lock);
+
+  int shared = 0;
+  for (int i = 0; i <= TEST_WAITERS; i++) {
+    pthread_join(threads[i], NULL);
+    TEST_ASSERT_EQUAL_INT(42, callers[i].result);
+    shared += callers[i].shared;
+  }
+
+  // Only a caller that ran fn itself gets an unshared result. A waiter that came too late for the
+  // first run starts its own, so the exact split depends on scheduling.
+  TEST_ASSERT_EQUAL_INT(0, callers[0].shared);
+  TEST_ASSERT_EQUAL_INT(TEST_WAITERS + 1, g_runs + shared);
+  TEST_ASSERT_GREATER_THAN(0, shared);
+
+  singleflight_destroy(sf);
+}
+
+void test_finished_call_is_not_reused(void) {
+  singleflight_t *sf = singleflight_create(4);
+  int value = 7;
+  int shared = -1;
+  TEST_ASSERT_NOT_NULL(sf);
+
+  g_runs = 0;
+  TEST_ASSERT_EQUAL_INT(7, singleflight_do(sf, TEST_KEY, strlen(TEST_KEY), count_run, &value, &shared));
+  TEST_ASSERT_EQUAL_INT(0, shared);
+
+  value = 8;
+  TEST_ASSERT_EQUAL_INT(8, singleflight_do(sf, TEST_KEY, strlen(TEST_KEY), count_run, &value, &shared));
+  TEST_ASSERT_EQUAL_INT(0, shared);
+  TEST_ASSERT_EQUAL_INT(2, g_runs);
+
+  singleflight_destroy(sf);
+}
+
+void test_long_key_runs_alone(void) {
+  char key[SINGLEFLIGHT_KEY_LEN];
+  singleflight_t *sf = singleflight_create(1);
+  int value = 3;
+  int shared = -1;
+  TEST_ASSERT_NOT_NULL(sf);
+
+  memset(key, 'k', sizeof(key));
+  g_runs = 0;
+  TEST_ASSERT_EQUAL_INT(3, singleflight_do(sf, key, sizeof(key), count_run, &value, &shared));
+  TEST_ASSERT_EQUAL_INT(0, shared);
+  TEST_ASSERT_EQUAL_INT(1, g_runs);
+
+  singleflight_destroy(sf);
+}
+
+int main() {
+  UNITY_BEGIN();
+
+  RUN_TEST(test_create_invalid);
+  RUN_TEST(test_concurrent_calls_share_one_run);
+  RUN_TEST(test_finished_call_is_not_reused);
+  RUN_TEST(test_long_key_runs_alone);
+
+  return UNITY_END();
+}
@@ -0,0 +1,227 @@
+/*
+ * This file is part of the IOTA Access distribution
+ * (https://github.com/iotaledger/access)
+ *
+ * Copyright (c) 2020 IOTA Stiftung
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * \project IOTA Access
+ * \file test_worker_pool.c
+ * \brief
+ * Unit tests for the worker pool
+ *
+ * \notes
+ *
+ * \history
+ * 16.10.2026. Initial version.
+ ****************************************************************************/
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "unity/unity.h"
+
+#include "worker_pool.h"
+
+#define TEST_MAX_JOBS 128
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_changed = PTHREAD_COND_INITIALIZER;
+static int g_gate_open;
+static int g_gate_waiting;
+static int g_jobs_run;
+static int g_bad_worker_idx;
+static int g_order[TEST_MAX_JOBS];
+
+static int g_lanes[] = {0, 1};
+static int g_gate_job;
+
+static void test_setup(void) {
+  g_gate_open = 0;
+  g_gate_waiting = 0;
+  g_jobs_run = 0;
+  g_bad_worker_idx = 0;
+}
+
+// Records the lane of every job in run order. The gate job holds its worker until the gate opens.
+static void job_cb(void *job, int worker_idx, void *user_data) {
+  int num_workers = *(int *)user_data;
+
+  pthread_mutex_lock(&g_lock);
+  if (worker_idx < 0 || worker_idx >= num_workers) {
+    g_bad_worker_idx = 1;
+  }
+
+  if (job == &g_gate_job) {
+    g_gate_waiting++;
+    pthread_cond_broadcast(&g_changed);
+    while (!g_gate_open) {
+      pthread_cond_wait(&g_changed, &g_lock);
+    }
+  } else {
+    g_order[g_jobs_run] = *(int *)job;
+    g_jobs_run++;
+    pthread_cond_broadcast(&g_changed);
+  }
+  pthread_mutex_unlock(&g_lock);
+}
+
+static void wait_for_gate(void) {
+  pthread_mutex_lock(&g_lock);
+  while (!g_gate_waiting) {
+    pthread_cond_wait(&g_changed, &g_lock);
+  }
+  pthread_mutex_unlock(&g_lock);
+}
+
+static void wait_for_jobs(int count) {
+  pthread_mutex_lock(&g_lock);
+  while (g_jobs_run < count) {
+    pthread_cond_wait(&g_changed, &g_lock);
+  }
+  pthread_mutex_unlock(&g_lock);
+}
+
+static void open_gate(void) {
+  pthread_mutex_lock(&g_lock);
+  g_gate_open = 1;
+  pthread_cond_broadcast(&g_changed);
+  pthread_mutex_unlock(&g_lock);
+}
+
+void test_create_invalid(void) {
+  int weights[WORKERPOOL_MAX_LANES + 1] = {1, 1, 1, 1, 1};
+  int num_workers = 1;
+
+  TEST_ASSERT_NULL(workerpool_create(0, 4, 1, weights, job_cb, &num_workers));
+  TEST_ASSERT_NULL(workerpool_create(1, 0, 1, weights, job_cb, &num_workers));
+  TEST_ASSERT_NULL(workerpool_create(1, 4, 0, weights, job_cb, &num_workers));
+  TEST_ASSERT_NULL(workerpool_create(1, 4, WORKERPOOL_MAX_LANES + 1, weights, job_cb, &num_workers));
+  TEST_ASSERT_NULL(workerpool_create(1, 4, 1, NULL, job_cb, &num_workers));
+  TEST_ASSERT_NULL(workerpool_create(1, 4, 1, weights, NULL, &num_workers));
+}
+
+void test_destroy_runs_queued_jobs(void) {
+  int weights[] = {1};
+  int num_workers = 4;
+
+  test_setup();
+  workerpool_t *pool = workerpool_create(num_workers, TEST_MAX_JOBS, 1, weights, job_cb, &num_workers);
+  TEST_ASSERT_NOT_NULL(pool);
+
+  for (int i = 0; i < TEST_MAX_JOBS; i++) {
+    TEST_ASSERT_EQUAL_INT(0, workerpool_submit(pool, &g_lanes[0], 0));
+  }
+  workerpool_destroy(pool);
+
+  TEST_ASSERT_EQUAL_INT(TEST_MAX_JOBS, g_jobs_run);
+  TEST_ASSERT_EQUAL_INT(0, g_bad_worker_idx);
+}
+
+void test_submit_rejects_full_queue_and_bad_lane(void) {
+  int weights[] = {1, 1};
+  int num_workers = 1;
+
+  test_setup();
+  workerpool_t *pool = workerpool_create(num_workers, 2, 2, weights, job_cb, &num_workers);
+  TEST_ASSERT_NOT_NULL(pool);
+
+  TEST_ASSERT_EQUAL_INT(0, workerpool_submit(pool, &g_gate_job, 0));
+  wait_for_gate();
+
+  TEST_ASSERT_EQUAL_INT(-1, workerpool_submit(pool, &g_lanes[0], 2));
+  TEST_ASSERT_EQUAL_INT(-1, workerpool_submit(pool, &g_lanes[0], -1));
+  TEST_ASSERT_EQUAL_INT(0, workerpool_submit(pool, &g_lanes[0], 0));
+  TEST_ASSERT_EQUAL_INT(0, workerpool_submit(pool, &g_lanes[1], 1));
+  TEST_ASSERT_EQUAL_INT(-1, workerpool_submit(pool, &g_lanes[1], 1));
+  TEST_ASSERT_EQUAL_INT(2, workerpool_pending(pool));
+
+  open_gate();
+  workerpool_destroy(pool);
+
+  TEST_ASSERT_EQUAL_INT(2, g_jobs_run);
+}
+
+void test_lanes_run_by_weight(void) {
+  int weights[] = {2, 1};
+  int num_workers = 1;
+  // The gate job took one of the two turns of lane 0 in the first round.
+  int expected[] = {0, 1, 0, 0, 1, 1};
+
+  test_setup();
+  workerpool_t *pool = workerpool_create(num_workers, TEST_MAX_JOBS, 2, weights, job_cb, &num_workers);
+  TEST_ASSERT_NOT_NULL(pool);
+
+  TEST_ASSERT_EQUAL_INT(0, workerpool_submit(pool, &g_gate_job, 0));
+  wait_for_gate();
+
+  for (int i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL_INT(0, workerpool_submit(pool, &g_lanes[1], 1));
+  }
+  for (int i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL_INT(0, workerpool_submit(pool, &g_lanes[0], 0));
+  }
+
+  open_gate();
+  workerpool_destroy(pool);
+
+  TEST_ASSERT_EQUAL_INT(6, g_jobs_run);
+  TEST_ASSERT_EQUAL_MEMORY(expected, g_order, sizeof(expected));
+}
+
+void test_lane_limit_keeps_workers_free(void) {
+  int weights[] = {1, 1};
+  int num_workers = 2;
+
+  test_setup();
+  workerpool_t *pool = workerpool_create(num_workers, TEST_MAX_JOBS, 2, weights, job_cb, &num_workers);
+  TEST_ASSERT_NOT_NULL(pool);
+  TEST_ASSERT_EQUAL_INT(-1, workerpool_set_lane_limit(pool, 2, 1));
+  TEST_ASSERT_EQUAL_INT(-1, workerpool_set_lane_limit(pool, 1, -1));
+  TEST_ASSERT_EQUAL_INT(0, workerpool_set_lane_limit(pool, 1, 1));
+
+  // Two blocking jobs in the limited lane occupy only one worker.
+  TEST_ASSERT_EQUAL_INT(0, workerpool_submit(pool, &g_gate_job, 1));
+  wait_for_gate();
+  TEST_ASSERT_EQUAL_INT(0, workerpool_submit(pool, &g_gate_job, 1));
+  TEST_ASSERT_EQUAL_INT(0, workerpool_submit(pool, &g_lanes[0], 0));
+
+  wait_for_jobs(1);
+  usleep(50 * 1000);
+  pthread_mutex_lock(&g_lock);
+  int gate_jobs_started = g_gate_waiting;
+  pthread_mutex_unlock(&g_lock);
+  TEST_ASSERT_EQUAL_INT(1, gate_jobs_started);
+  TEST_ASSERT_EQUAL_INT(1, workerpool_pending(pool));
+
+  open_gate();
+  workerpool_destroy(pool);
+
+  TEST_ASSERT_EQUAL_INT(2, g_gate_waiting);
+  TEST_ASSERT_EQUAL_INT(1, g_jobs_run);
+}
+
+int main() {
+  UNITY_BEGIN();
+
+  RUN_TEST(test_create_invalid);
+  RUN_TEST(test_destroy_runs_queued_jobs);
+  RUN_TEST(test_submit_rejects_full_queue_and_bad_lane);
+  RUN_TEST(test_lanes_run_by_weight);
+  RUN_TEST(test_lane_limit_keeps_workers_free);
+
+  return UNITY_END();
+}
@@ -0,0 +1,170 @@
+/*
+ * This file is part of the IOTA Access distribution
+ * (https://github.com/iotaledger/access)
+ *
+ * Copyright (c) 2020 IOTA Stiftung
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * \project IOTA Access
+ * \file test_pep_action_executor.c
+ * \brief
+ * Unit tests for the background PEP action executor
+ *
+ * \notes
+ *
+ * \history
+ * 16.10.2026. Initial version.
+ ****************************************************************************/
+
+#include <pthread.h>
+#include <string.h>
+
+#include "unity/unity.h"
+
+#include "pep_action_executor.h"
+
+#define TEST_QUEUE_LEN 4
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_changed = PTHREAD_COND_INITIALIZER;
+static int g_gate_open;
+static int g_gate_waiting;
+static int g_jobs_run;
+
+static void test_setup(void) {
+  g_gate_open = 0;
+  g_gate_waiting = 0;
+  g_jobs_run = 0;
+}
+
+// Actions named "gate" hold the executor until the gate opens, actions named "fail" fail.
+static int job_cb(pdp_action_t *action, char *obligation) {
+  pthread_mutex_lock(&g_lock);
+  if (strcmp(action->value, "gate") == 0) {
+    g_gate_waiting = 1;
+    pthread_cond_broadcast(&g_changed);
+    while (!g_gate_open) {
+      pthread_cond_wait(&g_changed, &g_lock);
+    }
+  }
+  g_jobs_run++;
+  pthread_cond_broadcast(&g_changed);
+  pthread_mutex_unlock(&g_lock);
+
+  return strcmp(action->value, "fail") == 0 ? -1 : 0;
+}
+
+static unsigned submit(pepexecutor_t *executor, const char *value) {
+  pdp_action_t action;
+
+  memset(&action, 0, sizeof(action));
+  strncpy(action.value, value, sizeof(action.value) - 1);
+
+  return pepexecutor_submit(executor, &action, NULL);
+}
+
+static void wait_for_gate(void) {
+  pthread_mutex_lock(&g_lock);
+  while (!g_gate_waiting) {
+    pthread_cond_wait(&g_changed, &g_lock);
+  }
+  pthread_mutex_unlock(&g_lock);
+}
+
+static void open_gate(void) {
+  pthread_mutex_lock(&g_lock);
+  g_gate_open = 1;
+  pthread_cond_broadcast(&g_changed);
+  pthread_mutex_unlock(&g_lock);
+}
+
+static void wait_for_jobs(int count) {
+  pthread_mutex_lock(&g_lock);
+  while (g_jobs_run < count) {
+    pthread_cond_wait(&g_changed, &g_lock);
+  }
+  pthread_mutex_unlock(&g_lock);
+}
+
+static void test_create_invalid(void) {
+  TEST_ASSERT_NULL(pepexecutor_create(0, job_cb));
+  TEST_ASSERT_NULL(pepexecutor_create(TEST_QUEUE_LEN, NULL));
+}
+
+static void test_job_states(void) {
+  test_setup();
+  pepexecutor_t *executor = pepexecutor_create(TEST_QUEUE_LEN, job_cb);
+  TEST_ASSERT_NOT_NULL(executor);
+
+  unsigned gate = submit(executor, "gate");
+  wait_for_gate();
+  unsigned done = submit(executor, "done");
+  unsigned failed = submit(executor, "fail");
+
+  TEST_ASSERT_NOT_EQUAL(0, gate);
+  TEST_ASSERT_NOT_EQUAL(gate, done);
+  TEST_ASSERT_EQUAL_INT(PEPEXECUTOR_JOB_RUNNING, pepexecutor_job_state(executor, gate));
+  TEST_ASSERT_EQUAL_INT(PEPEXECUTOR_JOB_PENDING, pepexecutor_job_state(executor, done));
+  TEST_ASSERT_EQUAL_INT(PEPEXECUTOR_JOB_PENDING, pepexecutor_job_state(executor, failed));
+
+  // Jobs run in order, so once the last one has started the others have their final state.
+  unsigned last = submit(executor, "done");
+  open_gate();
+  wait_for_jobs(4);
+
+  TEST_ASSERT_EQUAL_INT(PEPEXECUTOR_JOB_DONE, pepexecutor_job_state(executor, gate));
+  TEST_ASSERT_EQUAL_INT(PEPEXECUTOR_JOB_DONE, pepexecutor_job_state(executor, done));
+  TEST_ASSERT_EQUAL_INT(PEPEXECUTOR_JOB_FAILED, pepexecutor_job_state(executor, failed));
+  TEST_ASSERT_EQUAL_INT(PEPEXECUTOR_JOB_UNKNOWN, pepexecutor_job_state(executor, 0));
+  TEST_ASSERT_EQUAL_INT(PEPEXECUTOR_JOB_UNKNOWN, pepexecutor_job_state(executor, last + 1));
+
+  pepexecutor_destroy(executor);
+}
+
+static void test_full_queue_keeps_pending_states(void) {
+  unsigned ids[TEST_QUEUE_LEN];
+
+  test_setup();
+  pepexecutor_t *executor = pepexecutor_create(TEST_QUEUE_LEN, job_cb);
+  TEST_ASSERT_NOT_NULL(executor);
+
+  submit(executor, "gate");
+  wait_for_gate();
+  for (int i = 0; i < TEST_QUEUE_LEN; i++) {
+    ids[i] = submit(executor, "done");
+    TEST_ASSERT_NOT_EQUAL(0, ids[i]);
+  }
+  TEST_ASSERT_EQUAL_UINT(0, submit(executor, "done"));
+
+  for (int i = 0; i < TEST_QUEUE_LEN; i++) {
+    TEST_ASSERT_EQUAL_INT(PEPEXECUTOR_JOB_PENDING, pepexecutor_job_state(executor, ids[i]));
+  }
+
+  // Destroying runs what is still queued.
+  open_gate();
+  pepexecutor_destroy(executor);
+  TEST_ASSERT_EQUAL_INT(TEST_QUEUE_LEN + 1, g_jobs_run);
+}
+
+int main() {
+  UNITY_BEGIN();
+
+  RUN_TEST(test_create_invalid);
+  RUN_TEST(test_job_states);
+  RUN_TEST(test_full_queue_keeps_pending_states);
+
+  return UNITY_END();
+}
@@ -18,7 +18,9 @@
  */
 
 #include <inttypes.h>
+#include <string.h>
 
+#include "common/trinary/tryte_ascii.h"
 #include "utils/input_validators.h"
 #include "wallet.h"
 #include "wallet_logger.h"
@@ -341,6 +343,86 @@ done:
   return is_confirmed;
 }
 
+wallet_err_t wallet_check_payment(wallet_ctx_t const *const ctx, char const *const tx_hash, uint64_t *value,
+                                  char *message, size_t message_len) {
+  retcode_t client_ret = RC_ERROR;
+  wallet_err_t err = WALLET_ERR_UNKNOW;
+  flex_trit_t flex_tx[FLEX_TRIT_SIZE_243];
+  hash243_queue_t addresses = NULL;
+  hash243_queue_entry_t *q_iter = NULL;
+  tryte_t msg_trytes[NUM_TRYTES_MESSAGE];
+  char msg_ascii[NUM_TRYTES_MESSAGE / 2 + 1];
+
+  if (ctx == NULL || tx_hash == NULL || value == NULL || message == NULL || message_len == 0) {
+    log_error(wallet_logger_id, "[%s:%d] Invalid parameters.\n", __func__, __LINE__);
+    return WALLET_ERR_PRARMS;
+  }
+  *value = 0;
+  message[0] = '\0';
+
+  address_opt_t opt = {.security = ctx->security, .start = 0, .total = ctx->unused_idx + 1};
+  get_trytes_req_t *trytes_req = get_trytes_req_new();
+  transaction_array_t *txs = transaction_array_new();
+  if (!trytes_req || !txs) {
+    log_error(wallet_logger_id, "[%s:%d] OOM.\n", __func__, __LINE__);
+    err = WALLET_ERR_OOM;
+    goto done;
+  }
+
+  if (flex_trits_from_trytes(flex_tx, NUM_TRITS_HASH, tx_hash, NUM_TRYTES_HASH, NUM_TRYTES_HASH) == 0) {
+    log_error(wallet_logger_id, "[%s:%d] Converting flex_trit failed.\n", __func__, __LINE__);
+    err = WALLET_ERR_FLEX_TRITS;
+    goto done;
+  }
+
+  if ((client_ret = get_trytes_req_hash_add(trytes_req, flex_tx)) != RC_OK) {
+    log_error(wallet_logger_id, "[%s:%d] Adding hash failed.\n", __func__, __LINE__);
+    goto done;
+  }
+
+  if ((client_ret = iota_client_get_transaction_objects(ctx->iota_client, trytes_req, txs)) != RC_OK) {
+    log_error(wallet_logger_id, "[%s:%d] %s.\n", __func__, __LINE__, error_2_string(client_ret));
+    err = WALLET_ERR_CLIENT_ERR;
+    goto done;
+  }
+
+  iota_transaction_t *tx = transaction_array_at(txs, 0);
+  if (tx == NULL || transaction_value(tx) <= 0) {
+    err = WALLET_OK;
+    goto done;
+  }
+
+  if ((client_ret = iota_client_get_new_address(ctx->iota_client, ctx->seed, opt, &addresses)) != RC_OK) {
+    log_error(wallet_logger_id, "[%s:%d] %s.\n", __func__, __LINE__, error_2_string(client_ret));
+    err = WALLET_ERR_CLIENT_ERR;
+    goto done;
+  }
+
+  CDL_FOREACH(addresses, q_iter) {
+    if (memcmp(q_iter->hash, transaction_address(tx), FLEX_TRIT_SIZE_243) == 0) {
+      *value = (uint64_t)transaction_value(tx);
+      break;
+    }
+  }
+
+  // The padding of a short message decodes to NUL characters, which end the string.
+  if (*value > 0) {
+    flex_trits_to_trytes(msg_trytes, NUM_TRYTES_MESSAGE, transaction_message(tx), NUM_TRITS_MESSAGE,
+                         NUM_TRITS_MESSAGE);
+    memset(msg_ascii, 0, sizeof(msg_ascii));
+    trytes_to_ascii(msg_trytes, NUM_TRYTES_MESSAGE, msg_ascii);
+    strncpy(message, msg_ascii, message_len - 1);
+    message[message_len - 1] = '\0';
+  }
+  err = WALLET_OK;
+
+done:
+  hash243_queue_free(&addresses);
+  get_trytes_req_free(&trytes_req);
+  transaction_array_free(txs);
+  return err;
+}
+
 static void *confirmation_service(void *arg) {
   confirmation_service_t *serv = (confirmation_service_t *)arg;
   bool is_confirmed = false;
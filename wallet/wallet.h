@@ -172,6 +172,22 @@ wallet_err_t wallet_fetch_msg(wallet_ctx_t const *const ctx, char const *const h
  */
 bool wallet_check_confirmation(wallet_ctx_t const *const ctx, char const *const tx_hash);
 
+/**
+ * @brief Gets the amount a transaction moves to an address of this wallet, and its message.
+ *
+ * Addresses up to the recent unused index are checked, which covers every address handed out by
+ * wallet_get_address. The message is decoded as ASCII, the way wallet_send encodes it.
+ *
+ * @param ctx wallet context
+ * @param tx_hash a transaction hash
+ * @param value the value of the transaction, 0 if it does not pay this wallet
+ * @param message buffer for the message, empty if the transaction does not pay this wallet
+ * @param message_len size of the message buffer, longer messages are cut
+ * @return wallet_err_t
+ */
+wallet_err_t wallet_check_payment(wallet_ctx_t const *const ctx, char const *const tx_hash, uint64_t *value,
+                                  char *message, size_t message_len);
+
 // TODO wallet monitor
 
 /**